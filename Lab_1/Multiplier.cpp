@@ -1,6 +1,8 @@
 #pragma once
 
 #include "Matrix.cpp"
+#include "perfCounters.h"
+#include "threadPool.h"
 
 class Multiplier {
 public:
@@ -10,6 +12,7 @@ public:
     Multiplier(Matrix *a, Matrix *b) : a(a), b(b) {}
 
     virtual Matrix *multiply() {
+        PERF_REGION("multiply");
         auto result = new Matrix(a->rows, b->columns);
         for (int i = 0; i < result->rows; ++i) {
             for (int j = 0; j < result->columns; ++j) {
@@ -39,11 +42,15 @@ public:
         int tasks = rows * columns;
         auto result = new Matrix(a->rows, b->columns);
 
-#pragma omp parallel for schedule(static)
-        for (int task = 0; task < tasks; ++task) {
-            int row = task / columns;
-            int column = task % columns;
-            result->values[row][column] = getElement(row, column);
+#pragma omp parallel
+        {
+            PERF_REGION("multiply static");
+#pragma omp for schedule(static)
+            for (int task = 0; task < tasks; ++task) {
+                int row = task / columns;
+                int column = task % columns;
+                result->values[row][column] = getElement(row, column);
+            }
         }
         return result;
     }
@@ -59,11 +66,15 @@ public:
         int tasks = rows * columns;
         auto result = new Matrix(a->rows, b->columns);
 
-#pragma omp parallel for schedule(dynamic)
-        for (int task = 0; task < tasks; ++task) {
-            int row = task / columns;
-            int column = task % columns;
-            result->values[row][column] = getElement(row, column);
+#pragma omp parallel
+        {
+            PERF_REGION("multiply dynamic");
+#pragma omp for schedule(dynamic)
+            for (int task = 0; task < tasks; ++task) {
+                int row = task / columns;
+                int column = task % columns;
+                result->values[row][column] = getElement(row, column);
+            }
         }
         return result;
     }
@@ -79,12 +90,41 @@ public:
         int tasks = rows * columns;
         auto *result = new Matrix(a->rows, b->columns);
 
-#pragma omp parallel for schedule(guided)
-        for (int task = 0; task < tasks; ++task) {
-            int row = task / columns;
-            int column = task % columns;
-            result->values[row][column] = getElement(row, column);
+#pragma omp parallel
+        {
+            PERF_REGION("multiply guided");
+#pragma omp for schedule(guided)
+            for (int task = 0; task < tasks; ++task) {
+                int row = task / columns;
+                int column = task % columns;
+                result->values[row][column] = getElement(row, column);
+            }
         }
         return result;
     }
 };
+
+// the same tasks on persistent pinned threads, schedule is pool::STATIC, DYNAMIC or GUIDED
+class PoolMultiplier : public Multiplier {
+public:
+    pool::ThreadPool &workers;
+    int schedule;
+
+    PoolMultiplier(Matrix *a, Matrix *b, pool::ThreadPool &workers, int schedule)
+            : Multiplier(a, b), workers(workers), schedule(schedule) {}
+
+    Matrix *multiply() override {
+        int columns = b->columns;
+        int tasks = a->rows * columns;
+        auto *result = new Matrix(a->rows, b->columns);
+
+        workers.parallelFor(0, tasks, [&](int64_t begin, int64_t end) {
+            for (int task = begin; task < end; ++task) {
+                int row = task / columns;
+                int column = task % columns;
+                result->values[row][column] = getElement(row, column);
+            }
+        }, schedule);
+        return result;
+    }
+};
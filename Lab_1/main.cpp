@@ -5,7 +5,7 @@
 
 using namespace std;
 
-double multiply(int rows, int columns, int type) {
+double multiply(int rows, int columns, int type, pool::ThreadPool &workers) {
 
     auto A = new Matrix(rows, columns);
     auto B = new Matrix(rows, columns);
@@ -26,6 +26,15 @@ double multiply(int rows, int columns, int type) {
         case 3:
             multiplier = new GuidedScheduleMultiplier(A, B);
             break;
+        case 4:
+            multiplier = new PoolMultiplier(A, B, workers, pool::STATIC);
+            break;
+        case 5:
+            multiplier = new PoolMultiplier(A, B, workers, pool::DYNAMIC);
+            break;
+        case 6:
+            multiplier = new PoolMultiplier(A, B, workers, pool::GUIDED);
+            break;
     }
     auto start = chrono::high_resolution_clock::now();
     multiplier->multiply();
@@ -39,13 +48,16 @@ int main() {
     int type = 0;
     int execute_count = 5;
     double time = 0;
+    // threads of types 4-6, started once for all runs
+    pool::ThreadPool workers;
 
     for (int i = 0; i < execute_count; ++i) {
-        time += multiply(rows, columns, type);
+        time += multiply(rows, columns, type, workers);
     }
 
     time = time / execute_count;
     std::cout << "calculation time: " << time << std::endl;
+    perf::report(std::cerr);
 
     return 0;
 }
@@ -9,7 +9,7 @@ using namespace std;
 using namespace utils;
 using namespace multiplier;
 
-double multiply(int rowsA, int columnsA_rowsB, int columnsB, int mode, int chunkSize) {
+double multiply(int rowsA, int columnsA_rowsB, int columnsB, int mode, int chunkSize, pool::ThreadPool &workers) {
 
     string file1 = "matrix1.txt";
     string file2 = "matrix2.txt";
@@ -17,8 +17,6 @@ double multiply(int rowsA, int columnsA_rowsB, int columnsB, int mode, int chunk
     createFile(file1, rowsA, columnsA_rowsB);
     createFile(file2, columnsA_rowsB, columnsB);
 
-    int maxThreadNum = 4;
-    omp_set_num_threads(maxThreadNum);
     vector<vector<double>> a = loadMatrix(file1);
     vector<vector<double>> b = loadMatrix(file2);
 
@@ -62,6 +60,18 @@ double multiply(int rowsA, int columnsA_rowsB, int columnsB, int mode, int chunk
                            chunkSize, rows, inter, inter, columns, timeMultiply);
             break;
         }
+        case (4):
+        case (5):
+        case (6): {
+            static const char *const names[] = {"STATIC", "DYNAMIC", "GUIDED"};
+            int schedule = mode == 4 ? pool::STATIC : mode == 5 ? pool::DYNAMIC : pool::GUIDED;
+            result = multiplyParallelPool(a, b, chunkSize, workers, schedule);
+            timeMultiply = GetTickCount() - startTime;
+            res = snprintf(buf, sizeof(buf),
+                           "POOL %s MODE (chunkSize = %d) : %I64dx%I64d on %I64dx%I64d, Time: %I64d milliseconds\n",
+                           names[schedule], chunkSize, rows, inter, inter, columns, timeMultiply);
+            break;
+        }
         default:
             break;
     }
@@ -83,12 +93,18 @@ int main() {
     int execute_count = 5;
     ULONGLONG time = 0;
 
+    // both runtimes get their threads once, not on every run
+    int maxThreadNum = 4;
+    omp_set_num_threads(maxThreadNum);
+    pool::ThreadPool workers(maxThreadNum);
+
     for (int i = 0; i < execute_count; ++i) {
-        time += multiply(rowsA, columnsA_rowsB, columnsB, mode, chunkSize);
+        time += multiply(rowsA, columnsA_rowsB, columnsB, mode, chunkSize, workers);
     }
 
     time = time / execute_count;
     cout << "average time: " << time << endl;
+    perf::report(cerr);
 
     return 0;
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #include <vector>
 #include <iostream>
 #include <omp.h>
+#include "perfCounters.h"
+#include "threadPool.h"
 
 namespace multiplier {
     vector<vector<double>> multiplyInOneThead(vector<vector<double>> &a, vector<vector<double>> &b) {
@@ -8,6 +10,7 @@ namespace multiplier {
         int inter21 = b.size();
         int columns2 = b[0].size();
         vector<vector<double>> result(rows1, vector<double>(columns2, 0.0));
+        PERF_REGION("multiply one thread");
         for (int row = 0; row < rows1; row++) {
             for (int column = 0; column < columns2; column++) {
                 double sum = 0;
@@ -44,11 +47,15 @@ namespace multiplier {
                 result[row][column] = sum;
             }
         } else {
-#pragma omp parallel for schedule(static, chunkSize) shared(a, b)
-            for (int row = 0; row < rows1; row++) {
-                for (int column = 0; column < columns2; column++) {
-                    for (int inter = 0; inter < inter21; inter++) {
-                        result[row][column] += a[row][inter] * b[inter][column];
+#pragma omp parallel shared(a, b)
+            {
+                PERF_REGION("multiply static");
+#pragma omp for schedule(static, chunkSize)
+                for (int row = 0; row < rows1; row++) {
+                    for (int column = 0; column < columns2; column++) {
+                        for (int inter = 0; inter < inter21; inter++) {
+                            result[row][column] += a[row][inter] * b[inter][column];
+                        }
                     }
                 }
             }
@@ -81,11 +88,15 @@ namespace multiplier {
                 result[row][column] = sum;
             }
         } else {
-#pragma omp parallel for schedule(dynamic, chunkSize) shared(a, b)
-            for (int row = 0; row < rows1; row++) {
-                for (int column = 0; column < columns2; column++) {
-                    for (int inter = 0; inter < inter21; inter++) {
-                        result[row][column] += a[row][inter] * b[inter][column];
+#pragma omp parallel shared(a, b)
+            {
+                PERF_REGION("multiply dynamic");
+#pragma omp for schedule(dynamic, chunkSize)
+                for (int row = 0; row < rows1; row++) {
+                    for (int column = 0; column < columns2; column++) {
+                        for (int inter = 0; inter < inter21; inter++) {
+                            result[row][column] += a[row][inter] * b[inter][column];
+                        }
                     }
                 }
             }
@@ -117,15 +128,58 @@ namespace multiplier {
                 result[row][column] = sum;
             }
         } else {
-#pragma omp parallel for schedule(guided, chunkSize) shared(a, b)
-            for (int row = 0; row < rows1; row++) {
-                for (int column = 0; column < columns2; column++) {
-                    for (int inter = 0; inter < inter21; inter++) {
-                        result[row][column] += a[row][inter] * b[inter][column];
+#pragma omp parallel shared(a, b)
+            {
+                PERF_REGION("multiply guided");
+#pragma omp for schedule(guided, chunkSize)
+                for (int row = 0; row < rows1; row++) {
+                    for (int column = 0; column < columns2; column++) {
+                        for (int inter = 0; inter < inter21; inter++) {
+                            result[row][column] += a[row][inter] * b[inter][column];
+                        }
                     }
                 }
             }
         }
         return result;
     }
+
+    // the three cases above on persistent pinned threads, schedule is pool::STATIC, DYNAMIC or GUIDED
+    vector<vector<double>> multiplyParallelPool(vector<vector<double>> &a, vector<vector<double>> &b, int chunkSize,
+                                                pool::ThreadPool &workers, int schedule) {
+        int rows1 = a.size();
+        int inter21 = b.size();
+        int columns2 = b[0].size();
+        vector<vector<double>> result(rows1, vector<double>(columns2, 0.0));
+        if (rows1 == 1 && columns2 == 1) {
+            result[0][0] = workers.parallelReduce(0, inter21, 0.0, [&](int64_t begin, int64_t end, double &sum) {
+                for (int inner = begin; inner < end; inner++) {
+                    sum += a[0][inner] * b[inner][0];
+                }
+            }, [](double left, double right) { return left + right; }, schedule, chunkSize);
+        } else if (rows1 < 4) {
+            workers.parallelFor(0, rows1 * columns2, [&](int64_t begin, int64_t end) {
+                for (int i = begin; i < end; i++) {
+                    int column = i % columns2;
+                    int row = i / columns2;
+                    double sum = 0;
+                    for (int inner = 0; inner < inter21; inner++) {
+                        sum += a[row][inner] * b[inner][column];
+                    }
+                    result[row][column] = sum;
+                }
+            }, schedule, chunkSize);
+        } else {
+            workers.parallelFor(0, rows1, [&](int64_t begin, int64_t end) {
+                for (int row = begin; row < end; row++) {
+                    for (int column = 0; column < columns2; column++) {
+                        for (int inter = 0; inter < inter21; inter++) {
+                            result[row][column] += a[row][inter] * b[inter][column];
+                        }
+                    }
+                }
+            }, schedule, chunkSize);
+        }
+        return result;
+    }
 }
\ No newline at end of file
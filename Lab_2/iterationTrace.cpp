@@ -0,0 +1,134 @@
+#include "iterationTrace.h"
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+static const char *PHASE_NAMES[] = {"compute", "wait", "communication", "check"};
+
+void IterationTrace::enable(MPI_Comm communicator) {
+    // barrier gives all processes approximately the same time origin
+    MPI_Barrier(communicator);
+    origin = MPI_Wtime();
+    records.clear();
+    active = true;
+}
+
+void IterationTrace::write(const std::string &path, MPI_Comm communicator) {
+    int rank;
+    int size;
+    MPI_Comm_rank(communicator, &rank);
+    MPI_Comm_size(communicator, &size);
+
+    std::vector<double> local;
+    local.reserve(records.size() * RECORD_VALUES);
+    for (auto &record : records) {
+        local.push_back(record.start);
+        for (double duration : record.duration) {
+            local.push_back(duration);
+        }
+        local.push_back(record.residual);
+    }
+
+    int local_count = (int) local.size();
+    std::vector<int> counts(rank == 0 ? size : 0);
+    MPI_Gather(&local_count, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, communicator);
+
+    std::vector<int> displacements(counts.size());
+    std::vector<double> values;
+    if (rank == 0) {
+        for (int process = 0, offset = 0; process < size; process++) {
+            displacements[process] = offset;
+            offset += counts[process];
+        }
+        values.resize(displacements.back() + counts.back());
+    }
+    MPI_Gatherv(local.data(), local_count, MPI_DOUBLE, values.data(), counts.data(), displacements.data(),
+                MPI_DOUBLE, 0, communicator);
+
+    if (rank == 0) {
+        for (int &count : counts) {
+            count /= RECORD_VALUES;
+        }
+        writeJson(path, counts, values);
+        printSummary(counts, values);
+    }
+}
+
+void IterationTrace::writeJson(const std::string &path, const std::vector<int> &counts,
+                               const std::vector<double> &values) {
+    std::ofstream out(path);
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    const double *record = values.data();
+    for (int process = 0; process < (int) counts.size(); process++) {
+        for (int iteration = 0; iteration < counts[process]; iteration++, record += RECORD_VALUES) {
+            double start = record[0];
+            for (int phase = 0; phase < PHASES; phase++) {
+                double duration = record[1 + phase];
+                if (duration <= 0) {
+                    continue;
+                }
+                out << (first ? "" : ",\n") << "{\"name\":\"" << PHASE_NAMES[phase]
+                    << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << process << ",\"ts\":" << start * 1e6
+                    << ",\"dur\":" << duration * 1e6 << ",\"args\":{\"iteration\":" << iteration << "}}";
+                first = false;
+                start += duration;
+            }
+            if (process == 0) {
+                out << (first ? "" : ",\n") << "{\"name\":\"residual\",\"ph\":\"C\",\"pid\":0,\"ts\":" << start * 1e6
+                    << ",\"args\":{\"residual\":" << std::scientific << record[1 + PHASES] << std::fixed << "}}";
+                first = false;
+            }
+        }
+    }
+    out << "\n]}\n";
+}
+
+void IterationTrace::printSummary(const std::vector<int> &counts, const std::vector<double> &values) {
+    int size = (int) counts.size();
+    std::vector<double> totals(size * PHASES, 0);
+    const double *record = values.data();
+    for (int process = 0; process < size; process++) {
+        for (int iteration = 0; iteration < counts[process]; iteration++, record += RECORD_VALUES) {
+            for (int phase = 0; phase < PHASES; phase++) {
+                totals[process * PHASES + phase] += record[1 + phase];
+            }
+        }
+    }
+
+    std::cout << std::left << std::setw(6) << "rank" << std::setw(12) << "iterations";
+    for (auto name : PHASE_NAMES) {
+        std::cout << std::setw(15) << name;
+    }
+    std::cout << "\n" << std::fixed << std::setprecision(6);
+    for (int process = 0; process < size; process++) {
+        std::cout << std::setw(6) << process << std::setw(12) << counts[process];
+        for (int phase = 0; phase < PHASES; phase++) {
+            std::cout << std::setw(15) << totals[process * PHASES + phase];
+        }
+        std::cout << "\n";
+    }
+
+    double max_compute = 0;
+    double sum_compute = 0;
+    int slowest = 0;
+    for (int process = 0; process < size; process++) {
+        double compute = totals[process * PHASES + COMPUTE];
+        sum_compute += compute;
+        if (compute > max_compute) {
+            max_compute = compute;
+            slowest = process;
+        }
+    }
+    if (sum_compute > 0) {
+        std::cout << "slowest rank: " << slowest << ", compute imbalance (max / avg): "
+                  << max_compute / (sum_compute / size) << "\n";
+    }
+    if (counts[0] > 0) {
+        std::cout << "final residual: " << std::scientific << values[(counts[0] - 1) * RECORD_VALUES + 1 + PHASES]
+                  << "\n";
+    }
+    std::cout.unsetf(std::ios::floatfield);
+}
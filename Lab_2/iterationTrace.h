@@ -0,0 +1,83 @@
+#ifndef Lab_2_ITERATIONTRACE_H
+#define Lab_2_ITERATIONTRACE_H
+
+#include <vector>
+#include <string>
+#include "mpi.h"
+
+// per-iteration phase timings of one process, gathered on the main process at the end.
+// every call is a single branch while the trace is disabled.
+class IterationTrace {
+public:
+    enum Phase {
+        COMPUTE,
+        WAIT,
+        COMMUNICATION,
+        CHECK,
+        PHASES,
+    };
+
+    void enable(MPI_Comm communicator);
+
+    bool enabled() const {
+        return active;
+    }
+
+    void beginIteration() {
+        if (!active) {
+            return;
+        }
+        Record record{};
+        record.start = MPI_Wtime() - origin;
+        last_mark = record.start;
+        records.push_back(record);
+    }
+
+    void mark(Phase phase) {
+        if (!active) {
+            return;
+        }
+        double now = MPI_Wtime() - origin;
+        records.back().duration[phase] += now - last_mark;
+        last_mark = now;
+    }
+
+    // separates waiting for the slowest process from the data exchange itself
+    void waitOthers(MPI_Comm communicator) {
+        if (!active) {
+            return;
+        }
+        MPI_Barrier(communicator);
+        mark(WAIT);
+    }
+
+    void endIteration(double residual) {
+        if (!active) {
+            return;
+        }
+        records.back().residual = residual;
+    }
+
+    // collective, writes chrome trace-event json to path and prints summary table on the main process
+    void write(const std::string &path, MPI_Comm communicator);
+
+private:
+    struct Record {
+        double start;
+        double duration[PHASES];
+        double residual;
+    };
+
+    static const int RECORD_VALUES = PHASES + 2;
+
+    bool active = false;
+    double origin = 0;
+    double last_mark = 0;
+    std::vector<Record> records;
+
+    void writeJson(const std::string &path, const std::vector<int> &counts, const std::vector<double> &values);
+
+    void printSummary(const std::vector<int> &counts, const std::vector<double> &values);
+};
+
+#endif
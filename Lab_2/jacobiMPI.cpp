@@ -1,17 +1,31 @@
 #include "jacobiMPI.h"
+#include "perfCountersMPI.h"
 #include <vector>
 #include <cmath>
 #include <iostream>
+#include <cstring>
+
+static const char SYSTEM_MAGIC[8] = {'J', 'A', 'C', 'O', 'B', 'S', 'Y', 'S'};
+static const char RESULT_MAGIC[8] = {'J', 'A', 'C', 'O', 'B', 'R', 'E', 'S'};
+
+// rows share one contiguous block, so a row range can be filled by a single MPI-IO call
+ld **allocMatrix(int rows, int cols) {
+    ld **matrix = new ld *[rows > 0 ? rows : 1];
+    matrix[0] = new ld[(size_t) rows * cols];
+    for (int i = 1; i < rows; ++i) {
+        matrix[i] = matrix[0] + (size_t) i * cols;
+    }
+    return matrix;
+}
 
 std::pair<int, int> readMatrixAndFree(ld **&matrix, ld *&free, const std::string &path) {
     std::ifstream in(path);
     int n, m;
     in >> n >> m;
-    matrix = new ld *[n];
     free = new ld[n];
     m--;
+    matrix = allocMatrix(n, m);
     for (int i = 0; i < n; ++i) {
-        matrix[i] = new ld[m];
         for (int j = 0; j < m; j++) {
             in >> matrix[i][j];
         }
@@ -60,14 +74,15 @@ JacobiMPI::JacobiMPI(int argc, char **argv) {
 }
 
 JacobiMPI::~JacobiMPI() {
+    releaseSharedMemory();
     stopMPI();
     delete[] result;
     delete[] free;
     delete[] new_result;
-    for (int i = 0; i < process_matrix_size; i++) {
-        delete[] matrix[i];
+    if (matrix != nullptr) {
+        delete[] matrix[0];
+        delete[] matrix;
     }
-    delete[] matrix;
 }
 
 void JacobiMPI::prepareMPI(int argc, char **argv) {
@@ -75,27 +90,110 @@ void JacobiMPI::prepareMPI(int argc, char **argv) {
 }
 
 void JacobiMPI::stopMPI() {
+    perf::reportMPI(MPI_COMM_WORLD, MAIN_PROCESS, std::cerr);
     MPI_Finalize();
 }
 
 double JacobiMPI::run() {
     MPI_Comm_size(MPI_COMM_WORLD, &MPI_size);
     MPI_Comm_rank(MPI_COMM_WORLD, &MPI_rank);
-    if (MPI_rank == MAIN_PROCESS) {
-
-        if (argc < 5) {
-            std::cout << "usage: path1 path2 double path3\n"
+    if (argc < 5) {
+        if (MPI_rank == MAIN_PROCESS) {
+            std::cout << "usage: path1 path2 double path3 [options]\n"
                          "path1 - path to matrix\n"
                          "path2 - path to initial approximation\n"
                          "double - precision value\n"
-                         "path3 - path for output.\n";
-            exit(0);
+                         "path3 - path for output.\n"
+                         "options:\n"
+                         "--binary-input - path1 is a binary system file (matrix, free column and\n"
+                         "                 initial approximation), every process reads its own rows, path2 is ignored\n"
+                         "--binary-output - all processes write the result to path3 in binary format\n"
+                         "--to-binary - convert text path1 and path2 to a binary system file path3 and exit\n"
+                         "--shared-memory - processes of one node share a single solution vector,\n"
+                         "                  nodes exchange it through one leader process\n"
+                         "--async - asynchronous (chaotic) iterations: processes put their rows into\n"
+                         "          the other processes' windows and never wait for each other,\n"
+                         "          meant for diagonally dominant systems\n"
+                         "--trace=path - write per-process iteration timings as chrome trace json to path\n"
+                         "               and print a summary table\n";
+        }
+        exit(0);
+    }
+    readOptions();
+
+    if (shared_memory) {
+        prepareSharedMemory();
+    }
+
+    if (to_binary) {
+        if (MPI_rank == MAIN_PROCESS) {
+            readData();
+            writeSystemBinary();
+        }
+        return calc_time;
+    }
+
+    if (binary_input) {
+        readDataParallel();
+    } else {
+        if (MPI_rank == MAIN_PROCESS) {
+            readData();
+        }
+        distributeData();
+    }
+
+    if (shared_memory) {
+        allocSharedVectors();
+    }
+
+    if (!trace_path.empty()) {
+        trace.enable(communicator);
+    }
+
+    if (MPI_rank == MAIN_PROCESS) {
+        mainProcessRun();
+        std::cerr << matrix_rows << " " << MPI_size << " " << calc_time << std::endl;
+    } else {
+        otherProcessRun();
+    }
+
+    if (trace.enabled()) {
+        trace.write(trace_path, communicator);
+    }
+    return calc_time;
+}
+
+void JacobiMPI::readOptions() {
+    output = argv[4];
+    for (int i = 5; i < argc; i++) {
+        std::string option = argv[i];
+        if (option == "--binary-input") {
+            binary_input = true;
+        } else if (option == "--binary-output") {
+            binary_output = true;
+        } else if (option == "--to-binary") {
+            to_binary = true;
+        } else if (option == "--shared-memory") {
+            shared_memory = true;
+        } else if (option == "--async") {
+            async = true;
+        } else if (option.compare(0, 8, "--trace=") == 0) {
+            trace_path = option.substr(8);
+        } else if (MPI_rank == MAIN_PROCESS) {
+            std::cout << "unknown option: " << option << "\n";
+        }
+    }
+    if (async && shared_memory) {
+        if (MPI_rank == MAIN_PROCESS) {
+            std::cout << "--shared-memory is ignored in --async mode\n";
         }
-        readData();
+        shared_memory = false;
     }
+}
 
+void JacobiMPI::distributeData() {
     int matrix_info[] = {matrix_rows, matrix_cols};
-    MPI_Bcast(matrix_info, 2, MPI_INT, MAIN_PROCESS, MPI_COMM_WORLD);
+    MPI_Bcast(matrix_info, 2, MPI_INT, MAIN_PROCESS, communicator);
     matrix_rows = matrix_info[0];
     matrix_cols = matrix_info[1];
 
@@ -112,14 +210,6 @@ double JacobiMPI::run() {
         initOthers();
         recvInitial();
     }
-
-    if (MPI_rank == MAIN_PROCESS) {
-        mainProcessRun();
-        std::cerr << matrix_rows << " " << MPI_size << " " << calc_time << std::endl;
-    } else {
-        otherProcessRun();
-    }
-    return calc_time;
 }
 
 void JacobiMPI::mainProcessRun() {
@@ -129,7 +219,11 @@ void JacobiMPI::mainProcessRun() {
     calc_time = end_time - start_time;
 
     if (!failed) {
-        writeResult();
+        if (binary_output) {
+            writeResultParallel();
+        } else {
+            writeResult();
+        }
     } else {
         std::cout << "iterations limit exceeded, calculation failed\n";
     }
@@ -137,6 +231,9 @@ void JacobiMPI::mainProcessRun() {
 
 void JacobiMPI::otherProcessRun() {
     startSolve();
+    if (!failed && binary_output) {
+        writeResultParallel();
+    }
 }
 
 ld JacobiMPI::getMaxVectorsDiff() {
@@ -155,10 +252,50 @@ void JacobiMPI::writeResult() {
     }
 }
 
+void JacobiMPI::writeResultParallel() {
+    MPI_File file;
+    if (MPI_File_open(communicator, output.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file) !=
+        MPI_SUCCESS) {
+        if (MPI_rank == MAIN_PROCESS) {
+            std::cout << "can't open output file " << output << "\n";
+        }
+        MPI_Abort(communicator, 1);
+    }
+    MPI_File_set_size(file, 0);
+
+    SystemFileHeader header{};
+    memcpy(header.magic, RESULT_MAGIC, sizeof(header.magic));
+    header.rows = matrix_rows;
+    header.cols = 1;
+    header.value_size = sizeof(ld);
+    if (MPI_rank == MAIN_PROCESS) {
+        MPI_File_write_at(file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+
+    // every process owns the whole vector, but writes only its rows
+    MPI_Offset offset = sizeof(header) + (MPI_Offset) process_part_start * sizeof(ld);
+    MPI_File_write_at_all(file, offset, result + process_part_start, process_part_end - process_part_start,
+                          MPI_LONG_DOUBLE, MPI_STATUS_IGNORE);
+    MPI_File_close(&file);
+}
+
+void JacobiMPI::writeSystemBinary() {
+    std::ofstream out(output, std::ios::binary | std::ios::trunc);
+    SystemFileHeader header{};
+    memcpy(header.magic, SYSTEM_MAGIC, sizeof(header.magic));
+    header.rows = matrix_rows;
+    header.cols = matrix_cols;
+    header.value_size = sizeof(ld);
+    out.write((const char *) &header, sizeof(header));
+    out.write((const char *) matrix[0], (std::streamsize) matrix_rows * matrix_cols * sizeof(ld));
+    out.write((const char *) free, (std::streamsize) matrix_rows * sizeof(ld));
+    out.write((const char *) result, (std::streamsize) matrix_rows * sizeof(ld));
+}
+
 void JacobiMPI::mergeResult() {
     for (int process = 0; process < MPI_size; process++) {
         auto bounds = countProcessBounds(process);
-        MPI_Bcast(new_result + bounds.first, bounds.second - bounds.first, MPI_LONG_DOUBLE, process, MPI_COMM_WORLD);
+        MPI_Bcast(new_result + bounds.first, bounds.second - bounds.first, MPI_LONG_DOUBLE, process, communicator);
     }
 }
 
@@ -172,50 +309,108 @@ void JacobiMPI::readData() {
     output = argv[4];
 }
 
+void JacobiMPI::readDataParallel() {
+    MPI_File file;
+    if (MPI_File_open(communicator, argv[1], MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+        if (MPI_rank == MAIN_PROCESS) {
+            std::cout << "can't open system file " << argv[1] << "\n";
+        }
+        MPI_Abort(communicator, 1);
+    }
+
+    SystemFileHeader header{};
+    MPI_File_read_at_all(file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+    if (memcmp(header.magic, SYSTEM_MAGIC, sizeof(header.magic)) != 0 || header.value_size != sizeof(ld)) {
+        if (MPI_rank == MAIN_PROCESS) {
+            std::cout << "wrong system file format: " << argv[1] << "\n";
+        }
+        MPI_Abort(communicator, 1);
+    }
+    matrix_rows = (int) header.rows;
+    matrix_cols = (int) header.cols;
+    precision = atof(argv[3]);
+
+    matrix_part = matrix_rows / MPI_size;
+    auto bounds = countProcessBounds(MPI_rank);
+    process_part_start = bounds.first;
+    process_part_end = bounds.second;
+    process_matrix_size = process_part_end - process_part_start;
+    initOthers();
+
+    MPI_Datatype row_type;
+    MPI_Type_contiguous(matrix_cols, MPI_LONG_DOUBLE, &row_type);
+    MPI_Type_commit(&row_type);
+
+    MPI_Offset row_bytes = (MPI_Offset) matrix_cols * sizeof(ld);
+    MPI_Offset matrix_offset = sizeof(header);
+    MPI_Offset free_offset = matrix_offset + matrix_rows * row_bytes;
+    MPI_Offset initial_offset = free_offset + (MPI_Offset) matrix_rows * sizeof(ld);
+
+    MPI_File_read_at_all(file, matrix_offset + process_part_start * row_bytes, matrix[0], process_matrix_size,
+                         row_type, MPI_STATUS_IGNORE);
+    MPI_File_read_at_all(file, free_offset + (MPI_Offset) process_part_start * sizeof(ld), free,
+                         process_matrix_size, MPI_LONG_DOUBLE, MPI_STATUS_IGNORE);
+    MPI_File_read_at_all(file, initial_offset, result, matrix_rows, MPI_LONG_DOUBLE, MPI_STATUS_IGNORE);
+
+    MPI_Type_free(&row_type);
+    MPI_File_close(&file);
+}
+
 void JacobiMPI::initOthers() {
     result = new ld[matrix_rows];
     new_result = new ld[matrix_rows];
     free = new ld[process_matrix_size];
-    matrix = new ld *[process_matrix_size];
-    for (int i = 0; i < process_matrix_size; ++i) {
-        matrix[i] = new ld[matrix_cols];
-    }
+    matrix = allocMatrix(process_matrix_size, matrix_cols);
 }
 
 void JacobiMPI::sendInitial() {
-    MPI_Bcast(&precision, 1, MPI_LONG_DOUBLE, MAIN_PROCESS, MPI_COMM_WORLD);
-    MPI_Bcast(result, matrix_rows, MPI_LONG_DOUBLE, MAIN_PROCESS, MPI_COMM_WORLD);
+    MPI_Bcast(&precision, 1, MPI_LONG_DOUBLE, MAIN_PROCESS, communicator);
+    MPI_Bcast(result, matrix_rows, MPI_LONG_DOUBLE, MAIN_PROCESS, communicator);
     MPI_Request r;
     for (int process = 0; process < MPI_size; process++) {
         auto bounds = countProcessBounds(process);
-        MPI_Isend(free + bounds.first, bounds.second - bounds.first, MPI_LONG_DOUBLE, process, FREE, MPI_COMM_WORLD,
+        MPI_Isend(free + bounds.first, bounds.second - bounds.first, MPI_LONG_DOUBLE, process, FREE, communicator,
                   &r);
         for (int i = bounds.first; i < bounds.second; i++) {
-            MPI_Isend(matrix[i], matrix_cols, MPI_LONG_DOUBLE, process, MATRIX, MPI_COMM_WORLD, &r);
+            MPI_Isend(matrix[i], matrix_cols, MPI_LONG_DOUBLE, process, MATRIX, communicator, &r);
         }
     }
 }
 
 void JacobiMPI::recvInitial() {
-    MPI_Bcast(&precision, 1, MPI_LONG_DOUBLE, MAIN_PROCESS, MPI_COMM_WORLD);
-    MPI_Bcast(result, matrix_rows, MPI_LONG_DOUBLE, MAIN_PROCESS, MPI_COMM_WORLD);
-    MPI_Recv(free, process_part_end - process_part_start, MPI_LONG_DOUBLE, MAIN_PROCESS, FREE, MPI_COMM_WORLD,
+    MPI_Bcast(&precision, 1, MPI_LONG_DOUBLE, MAIN_PROCESS, communicator);
+    MPI_Bcast(result, matrix_rows, MPI_LONG_DOUBLE, MAIN_PROCESS, communicator);
+    MPI_Recv(free, process_part_end - process_part_start, MPI_LONG_DOUBLE, MAIN_PROCESS, FREE, communicator,
              MPI_STATUS_IGNORE);
     for (int i = 0; i < process_matrix_size; i++) {
-        MPI_Recv(matrix[i], matrix_cols, MPI_LONG_DOUBLE, MAIN_PROCESS, MATRIX, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        MPI_Recv(matrix[i], matrix_cols, MPI_LONG_DOUBLE, MAIN_PROCESS, MATRIX, communicator, MPI_STATUS_IGNORE);
     }
 }
 
 void JacobiMPI::startSolve() {
+    if (shared_memory) {
+        startSolveShared();
+        return;
+    }
+    if (async) {
+        startSolveAsync();
+        return;
+    }
     while (true) {
+        trace.beginIteration();
         bool over = solvePart(process_part_start, process_part_end);
+        trace.mark(IterationTrace::COMPUTE);
+        trace.waitOthers(communicator);
         mergeResult();
+        trace.mark(IterationTrace::COMMUNICATION);
         ld diff = getMaxVectorsDiff();
         bool done = diff < precision;
 
         for (int i = 0; i < matrix_rows; i++) {
             result[i] = new_result[i];
         }
+        trace.mark(IterationTrace::CHECK);
+        trace.endIteration((double) diff);
 
         if (over && !done) {
             failed = true;
@@ -227,10 +422,244 @@ void JacobiMPI::startSolve() {
     }
 }
 
+void JacobiMPI::prepareSharedMemory() {
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, MPI_rank, MPI_INFO_NULL, &node_communicator);
+    MPI_Comm_rank(node_communicator, &node_rank);
+    MPI_Comm_size(node_communicator, &node_size);
+    MPI_Comm_split(MPI_COMM_WORLD, node_rank == 0 ? 0 : MPI_UNDEFINED, MPI_rank, &leaders_communicator);
+
+    int node_offset = 0;
+    if (leaders_communicator != MPI_COMM_NULL) {
+        int leader_rank;
+        MPI_Comm_rank(leaders_communicator, &leader_rank);
+        MPI_Exscan(&node_size, &node_offset, 1, MPI_INT, MPI_SUM, leaders_communicator);
+        if (leader_rank == 0) {
+            node_offset = 0;
+        }
+    }
+    MPI_Bcast(&node_offset, 1, MPI_INT, 0, node_communicator);
+
+    // renumber processes node by node, so every node owns one contiguous block of rows
+    MPI_Comm_split(MPI_COMM_WORLD, 0, node_offset + node_rank, &communicator);
+    MPI_Comm_rank(communicator, &MPI_rank);
+}
+
+void JacobiMPI::allocSharedVectors() {
+    MPI_Aint window_size = node_rank == 0 ? 2 * (MPI_Aint) matrix_rows * sizeof(ld) : 0;
+    ld *base;
+    MPI_Win_allocate_shared(window_size, sizeof(ld), MPI_INFO_NULL, node_communicator, &base, &shared_window);
+    MPI_Aint segment_size;
+    int displacement_unit;
+    MPI_Win_shared_query(shared_window, 0, &segment_size, &displacement_unit, &base);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, shared_window);
+
+    if (node_rank == 0) {
+        for (int i = 0; i < matrix_rows; i++) {
+            base[i] = result[i];
+        }
+    }
+    delete[] result;
+    delete[] new_result;
+    result = base;
+    new_result = base + matrix_rows;
+
+    MPI_Win_sync(shared_window);
+    MPI_Barrier(node_communicator);
+    MPI_Win_sync(shared_window);
+
+    if (leaders_communicator != MPI_COMM_NULL) {
+        int leaders;
+        MPI_Comm_size(leaders_communicator, &leaders);
+        int node_offset = MPI_rank - node_rank;
+        int node_start = countProcessBounds(node_offset).first;
+        int node_end = countProcessBounds(node_offset + node_size - 1).second;
+        int node_bounds[] = {node_start, node_end - node_start};
+        std::vector<int> all_bounds(2 * leaders);
+        MPI_Allgather(node_bounds, 2, MPI_INT, all_bounds.data(), 2, MPI_INT, leaders_communicator);
+        node_starts.resize(leaders);
+        node_counts.resize(leaders);
+        for (int leader = 0; leader < leaders; leader++) {
+            node_starts[leader] = all_bounds[2 * leader];
+            node_counts[leader] = all_bounds[2 * leader + 1];
+        }
+    }
+}
+
+void JacobiMPI::releaseSharedMemory() {
+    if (shared_window != MPI_WIN_NULL) {
+        MPI_Win_unlock_all(shared_window);
+        MPI_Win_free(&shared_window);
+        result = nullptr;
+        new_result = nullptr;
+    }
+    if (leaders_communicator != MPI_COMM_NULL) {
+        MPI_Comm_free(&leaders_communicator);
+    }
+    if (node_communicator != MPI_COMM_NULL) {
+        MPI_Comm_free(&node_communicator);
+    }
+    if (communicator != MPI_COMM_WORLD) {
+        MPI_Comm_free(&communicator);
+    }
+}
+
+void JacobiMPI::mergeResultShared() {
+    MPI_Win_sync(shared_window);
+    MPI_Barrier(node_communicator);
+    if (leaders_communicator != MPI_COMM_NULL) {
+        MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, new_result, node_counts.data(), node_starts.data(),
+                       MPI_LONG_DOUBLE, leaders_communicator);
+    }
+    MPI_Barrier(node_communicator);
+    MPI_Win_sync(shared_window);
+}
+
+void JacobiMPI::startSolveShared() {
+    while (true) {
+        trace.beginIteration();
+        bool over = solvePart(process_part_start, process_part_end);
+        trace.mark(IterationTrace::COMPUTE);
+        trace.waitOthers(communicator);
+        mergeResultShared();
+        trace.mark(IterationTrace::COMMUNICATION);
+
+        // vectors are shared, so every process checks only its own rows
+        ld local_diff = 0;
+        for (int i = process_part_start; i < process_part_end; i++) {
+            local_diff = std::max(local_diff, std::fabs(result[i] - new_result[i]));
+        }
+        ld diff;
+        MPI_Allreduce(&local_diff, &diff, 1, MPI_LONG_DOUBLE, MPI_MAX, communicator);
+        bool done = diff < precision;
+
+        // allreduce guarantees nobody reads the old vector anymore
+        std::swap(result, new_result);
+        trace.mark(IterationTrace::CHECK);
+        trace.endIteration((double) diff);
+
+        if (over && !done) {
+            failed = true;
+        }
+
+        if (done || failed) {
+            break;
+        }
+    }
+}
+
+void JacobiMPI::startSolveAsync() {
+    ld *window_base;
+    MPI_Win window;
+    MPI_Win_allocate((MPI_Aint) matrix_rows * sizeof(ld), sizeof(ld), MPI_INFO_NULL, communicator, &window_base,
+                     &window);
+    for (int i = 0; i < matrix_rows; i++) {
+        window_base[i] = result[i];
+    }
+    MPI_Barrier(communicator);
+    MPI_Win_lock_all(0, window);
+
+    int part_size = process_part_end - process_part_start;
+    // own diff and minus the own iteration count, so one MAX reduction gives the largest diff and the fewest
+    // iterations: the limit is reached only when the slowest process has used it up
+    ld local_state[2];
+    ld global_state[2];
+    MPI_Request reduction = MPI_REQUEST_NULL;
+    int iterations = 0;
+
+    auto partDiff = [&]() {
+        ld diff = 0;
+        for (int i = process_part_start; i < process_part_end; i++) {
+            diff = std::max(diff, std::fabs(result[i] - new_result[i]));
+        }
+        return diff;
+    };
+    // accumulate operations are element-wise atomic, so readers never see a half-written value
+    auto putPart = [&]() {
+        for (int process = 0; process < MPI_size; process++) {
+            MPI_Accumulate(new_result + process_part_start, part_size, MPI_LONG_DOUBLE, process, process_part_start,
+                           part_size, MPI_LONG_DOUBLE, MPI_REPLACE, window);
+        }
+    };
+    auto fetchResult = [&]() {
+        MPI_Get_accumulate(nullptr, 0, MPI_LONG_DOUBLE, result, matrix_rows, MPI_LONG_DOUBLE, MPI_rank, 0,
+                           matrix_rows, MPI_LONG_DOUBLE, MPI_NO_OP, window);
+        MPI_Win_flush(MPI_rank, window);
+    };
+
+    while (true) {
+        trace.beginIteration();
+        solvePart(process_part_start, process_part_end);
+        iterations++;
+        ld diff = partDiff();
+        trace.mark(IterationTrace::COMPUTE);
+
+        putPart();
+        MPI_Win_flush_local_all(window);
+        // continue with whatever values have arrived from the others
+        fetchResult();
+        trace.mark(IterationTrace::COMMUNICATION);
+
+        // termination: non-blocking reduction of the latest local state, a new one starts when the previous is over
+        if (reduction == MPI_REQUEST_NULL) {
+            local_state[0] = diff;
+            local_state[1] = -iterations;
+            MPI_Iallreduce(local_state, global_state, 2, MPI_LONG_DOUBLE, MPI_MAX, communicator, &reduction);
+        }
+        int finished;
+        MPI_Test(&reduction, &finished, MPI_STATUS_IGNORE);
+        trace.mark(IterationTrace::CHECK);
+        trace.endIteration((double) diff);
+
+        if (!finished) {
+            continue;
+        }
+        if (global_state[0] < precision) {
+            // only a candidate, the diffs were taken against partly arrived values: every put is completed and
+            // one synchronous sweep over the same values everywhere has to confirm it
+            trace.beginIteration();
+            MPI_Win_flush_all(window);
+            MPI_Barrier(communicator);
+            fetchResult();
+            solvePart(process_part_start, process_part_end);
+            iterations++;
+            diff = partDiff();
+            trace.mark(IterationTrace::COMPUTE);
+            MPI_Barrier(communicator);
+            putPart();
+            MPI_Win_flush_all(window);
+            trace.mark(IterationTrace::COMMUNICATION);
+            local_state[0] = diff;
+            local_state[1] = -iterations;
+            MPI_Allreduce(local_state, global_state, 2, MPI_LONG_DOUBLE, MPI_MAX, communicator);
+            trace.mark(IterationTrace::CHECK);
+            trace.endIteration((double) diff);
+            if (global_state[0] < precision) {
+                break;
+            }
+            fetchResult();
+        }
+        if (-global_state[1] > MAX_ITERATIONS) {
+            failed = true;
+            break;
+        }
+    }
+
+    // every process leaves after the same reduction, so the last puts are complete after the barrier
+    MPI_Win_unlock_all(window);
+    MPI_Barrier(communicator);
+    MPI_Win_lock(MPI_LOCK_SHARED, MPI_rank, 0, window);
+    for (int i = 0; i < matrix_rows; i++) {
+        result[i] = window_base[i];
+    }
+    MPI_Win_unlock(MPI_rank, window);
+    MPI_Win_free(&window);
+}
+
 bool JacobiMPI::solvePart(int index_from, int index_to) {
     static int iteration = 0;
-    static const int MAX_ITERATIONS = 1000;
-    int offset = (MPI_rank == MAIN_PROCESS ? 0 : index_from);
+    // main process keeps the whole matrix after text input, but its rows start from zero anyway
+    int offset = index_from;
+    PERF_REGION("solvePart");
 
     for (int i = index_from; i < index_to; i++) {
         ld sum = 0;
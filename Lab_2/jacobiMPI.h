@@ -3,11 +3,21 @@
 
 #include <vector>
 #include "mpi.h"
+#include "iterationTrace.h"
 #include <string>
 #include <fstream>
+#include <cstdint>
 
 typedef long double ld;
 
+// binary layout: header, matrix (rows x cols, row-major), free column, initial approximation
+struct SystemFileHeader {
+    char magic[8];
+    int64_t rows;
+    int64_t cols;
+    int64_t value_size;
+};
+
 class JacobiMPI {
 public:
     JacobiMPI(int argc, char **argv);
@@ -24,14 +34,18 @@ private:
         MATRIX,
     };
 
+    static const int MAX_ITERATIONS = 1000;
 
-    ld **matrix;
-    ld *result;
-    ld *new_result;
-    ld *free;
+
+    ld **matrix = nullptr;
+    ld *result = nullptr;
+    ld *new_result = nullptr;
+    ld *free = nullptr;
     ld precision;
 
     std::string output;
+    std::string trace_path;
+    IterationTrace trace;
     int argc;
     char **argv;
 
@@ -43,9 +57,23 @@ private:
     int matrix_rows;
     int matrix_cols;
     bool failed = false;
+    bool binary_input = false;
+    bool binary_output = false;
+    bool to_binary = false;
+    bool shared_memory = false;
+    bool async = false;
     double calc_time = -1;
     int MPI_size;
     int MPI_rank;
+    MPI_Comm communicator = MPI_COMM_WORLD;
+
+    MPI_Comm node_communicator = MPI_COMM_NULL;
+    MPI_Comm leaders_communicator = MPI_COMM_NULL;
+    MPI_Win shared_window = MPI_WIN_NULL;
+    int node_rank = 0;
+    int node_size = 1;
+    std::vector<int> node_starts;
+    std::vector<int> node_counts;
 
 
     ld getMaxVectorsDiff();
@@ -66,6 +94,28 @@ private:
 
     void readData();
 
+    void readOptions();
+
+    void readDataParallel();
+
+    void writeResultParallel();
+
+    void writeSystemBinary();
+
+    void distributeData();
+
+    void prepareSharedMemory();
+
+    void allocSharedVectors();
+
+    void releaseSharedMemory();
+
+    void startSolveShared();
+
+    void mergeResultShared();
+
+    void startSolveAsync();
+
     void sendInitial();
 
     void recvInitial();
@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "quickSortMPI.h"
+#include "quickSortThreads.h"
+
+enum distributions {
+    UNIFORM,
+    SORTED,
+    REVERSE_SORTED,
+    FEW_UNIQUE,
+    ZIPF,
+    ORGAN_PIPE,
+    ALL_EQUAL,
+    DISTRIBUTIONS,
+};
+
+// both engines hand out keys equal to a pivot or splitter by count, so inputs made of ties must still come out
+// even; a larger max / avg on them is reported next to the row
+static const double TIES_IMBALANCE = 1.05;
+
+static const char *DISTRIBUTION_NAMES[] = {"uniform", "sorted", "reverse", "few-unique", "zipf", "organ-pipe",
+                                           "all-equal"};
+
+std::vector<int> generate(int distribution, int size, unsigned seed) {
+    static const int FEW = 16;
+    static const int ZIPF_VALUES = 1 << 16;
+    std::mt19937 generator(seed);
+    std::vector<int> keys(size);
+    switch (distribution) {
+        case UNIFORM: {
+            std::uniform_int_distribution<int> values(INT32_MIN, INT32_MAX);
+            for (int &key : keys) {
+                key = values(generator);
+            }
+            break;
+        }
+        case SORTED:
+            for (int i = 0; i < size; i++) {
+                keys[i] = i;
+            }
+            break;
+        case REVERSE_SORTED:
+            for (int i = 0; i < size; i++) {
+                keys[i] = size - i;
+            }
+            break;
+        case FEW_UNIQUE: {
+            std::uniform_int_distribution<int> values(0, FEW - 1);
+            for (int &key : keys) {
+                key = values(generator) * 1000;
+            }
+            break;
+        }
+        case ZIPF: {
+            // rank k has weight 1 / k^1.2, ranks are scattered over the key range
+            std::vector<double> weights(ZIPF_VALUES);
+            for (int k = 0; k < ZIPF_VALUES; k++) {
+                weights[k] = 1.0 / std::pow(k + 1.0, 1.2);
+            }
+            std::discrete_distribution<int> values(weights.begin(), weights.end());
+            for (int &key : keys) {
+                key = (int) ((unsigned) values(generator) * 2654435761u);
+            }
+            break;
+        }
+        case ORGAN_PIPE:
+            for (int i = 0; i < size; i++) {
+                keys[i] = i < size / 2 ? i : size - i;
+            }
+            break;
+        default:
+            std::fill(keys.begin(), keys.end(), 42);
+            break;
+    }
+    return keys;
+}
+
+// MPI_Barrier spins in most implementations, ranks waiting here sleep between tests and leave their cores
+// to whatever rank 0 runs meanwhile
+void sleepingBarrier(MPI_Comm comm) {
+    MPI_Request request;
+    MPI_Ibarrier(comm, &request);
+    int done = 0;
+    MPI_Test(&request, &done, MPI_STATUS_IGNORE);
+    while (!done) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        MPI_Test(&request, &done, MPI_STATUS_IGNORE);
+    }
+}
+
+int main(int argc, char **argv) {
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    int rank;
+    int size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    std::vector<int> sizes;
+    std::vector<std::string> options;
+    int repeat = 3;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--help") {
+            if (rank == 0) {
+                std::cout << "usage: mpirun -np P Lab_3_bench [size...] [--repeat=N] [options]\n"
+                             "size - number of keys, 65536 1048576 4194304 by default,\n"
+                             "--repeat=N - runs per case, the best one is reported (default 3),\n"
+                             "options - passed to QuickSortMPI, for example --local-sort=radix,\n"
+                             "process count is the one given to mpirun.\n";
+            }
+            MPI_Finalize();
+            return 0;
+        } else if (arg.compare(0, 9, "--repeat=") == 0) {
+            repeat = std::max(1, atoi(arg.c_str() + 9));
+        } else if (arg.compare(0, 2, "--") == 0) {
+            options.push_back(arg);
+        } else {
+            sizes.push_back(atoi(arg.c_str()));
+        }
+    }
+    if (sizes.empty()) {
+        sizes = {1 << 16, 1 << 20, 1 << 22};
+    }
+
+    if (rank == 0) {
+        std::cout << std::left << std::setw(12) << "input" << std::setw(10) << "keys" << std::setw(7) << "procs"
+                  << std::setw(11) << "engine" << std::setw(11) << "time" << std::setw(11) << "Mkeys/s"
+                  << std::setw(11) << "distribute" << std::setw(11) << "partition" << std::setw(11) << "local"
+                  << std::setw(11) << "gather" << std::setw(10) << "imbalance" << "\n"
+                  << std::fixed;
+    }
+
+    const char *engines[] = {"hypercube", "psrs"};
+    for (int keys_count : sizes) {
+        for (int distribution = 0; distribution < DISTRIBUTIONS; distribution++) {
+            std::vector<int> input;
+            std::vector<int> reference;
+            if (rank == 0) {
+                input = generate(distribution, keys_count, 12345 + distribution);
+                reference = input;
+                std::sort(reference.begin(), reference.end());
+            }
+
+            for (auto engine : engines) {
+                std::vector<std::string> arguments = {argv[0], "-", "-", std::string("--engine=") + engine};
+                arguments.insert(arguments.end(), options.begin(), options.end());
+                std::vector<char *> engine_argv;
+                for (auto &argument : arguments) {
+                    engine_argv.push_back(&argument[0]);
+                }
+
+                double best = -1;
+                std::vector<double> best_max;
+                std::vector<double> best_avg;
+                bool sorted = true;
+                for (int run = 0; run < repeat; run++) {
+                    QuickSortMPI sorter(engine_argv.size(), engine_argv.data());
+                    std::vector<int> keys = input;
+                    double time = sorter.sortInMemory(keys);
+                    std::vector<double> max_values;
+                    std::vector<double> avg_values;
+                    sorter.phaseSummary(max_values, avg_values);
+                    if (rank == 0) {
+                        sorted = sorted && keys == reference;
+                        if (best < 0 || time < best) {
+                            best = time;
+                            best_max = max_values;
+                            best_avg = avg_values;
+                        }
+                    }
+                }
+
+                if (rank == 0) {
+                    double imbalance = best_avg[QuickSortMPI::PHASES] > 0 ?
+                                       best_max[QuickSortMPI::PHASES] / best_avg[QuickSortMPI::PHASES] : 1;
+                    bool balanced = (distribution != FEW_UNIQUE && distribution != ALL_EQUAL) ||
+                                    imbalance <= TIES_IMBALANCE;
+                    std::cout << std::setw(12) << DISTRIBUTION_NAMES[distribution] << std::setw(10) << keys_count
+                              << std::setw(7) << size << std::setw(11) << engine << std::setprecision(6)
+                              << std::setw(11) << best << std::setprecision(2) << std::setw(11)
+                              << keys_count / best / 1e6 << std::setprecision(6);
+                    for (int phase = 0; phase < QuickSortMPI::PHASES; phase++) {
+                        std::cout << std::setw(11) << best_max[phase];
+                    }
+                    std::cout << std::setprecision(3) << std::setw(10) << imbalance
+                              << (sorted ? "" : " NOT SORTED") << (balanced ? "" : " UNBALANCED") << "\n";
+                }
+            }
+
+            // shared-memory sort on the same number of cores for comparison, the other ranks sleep meanwhile
+            if (rank == 0) {
+                double best = -1;
+                bool sorted = true;
+                for (int run = 0; run < repeat; run++) {
+                    std::vector<int> keys = input;
+                    double start_time = MPI_Wtime();
+                    QuickSortThreads::sort(keys, size);
+                    double time = MPI_Wtime() - start_time;
+                    sorted = sorted && keys == reference;
+                    if (best < 0 || time < best) {
+                        best = time;
+                    }
+                }
+                std::cout << std::setw(12) << DISTRIBUTION_NAMES[distribution] << std::setw(10) << keys_count
+                          << std::setw(7) << size << std::setw(11) << "threads" << std::setprecision(6)
+                          << std::setw(11) << best << std::setprecision(2) << std::setw(11)
+                          << keys_count / best / 1e6 << std::setprecision(6) << (sorted ? "" : " NOT SORTED")
+                          << "\n";
+            }
+            sleepingBarrier(MPI_COMM_WORLD);
+        }
+    }
+
+    MPI_Finalize();
+    return 0;
+}
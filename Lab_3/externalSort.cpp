@@ -0,0 +1,332 @@
+#include "quickSortMPI.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <queue>
+#include <functional>
+#include <unistd.h>
+
+// sequential reader of a sorted run, the next buffer is read in background while the current one is merged
+class RunReader {
+public:
+    RunReader(const std::string &path, size_t buffer_size) : current(buffer_size), ahead(buffer_size) {
+        file = fopen(path.c_str(), "rb");
+        if (file == nullptr) {
+            std::cout << "can't open run file " << path << "\n";
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        current_size = fread(current.data(), sizeof(int), current.size(), file);
+        prefetch();
+    }
+
+    ~RunReader() {
+        if (pending.valid()) {
+            pending.wait();
+        }
+        fclose(file);
+    }
+
+    bool empty() const {
+        return position == current_size;
+    }
+
+    int top() const {
+        return current[position];
+    }
+
+    void next() {
+        if (++position < current_size) {
+            return;
+        }
+        current_size = pending.get();
+        position = 0;
+        if (current_size > 0) {
+            std::swap(current, ahead);
+            prefetch();
+        }
+    }
+
+private:
+    FILE *file;
+    std::vector<int> current;
+    std::vector<int> ahead;
+    size_t current_size = 0;
+    size_t position = 0;
+    std::future<size_t> pending;
+
+    void prefetch() {
+        pending = std::async(std::launch::async, [this]() {
+            return fread(ahead.data(), sizeof(int), ahead.size(), file);
+        });
+    }
+};
+
+static FILE *openRun(const std::string &path, const char *mode) {
+    FILE *file = fopen(path.c_str(), mode);
+    if (file == nullptr) {
+        std::cout << "can't open run file " << path << "\n";
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    return file;
+}
+
+std::string QuickSortMPI::runPath(int index) {
+    return temp_dir + "/qsort_" + std::to_string(getpid()) + "_" + std::to_string(MPI_initial_rank) + "_" +
+           std::to_string(index) + ".run";
+}
+
+// memory use: sorted runs of budget / 2 keys, send, receive and merged exchange blocks of budget / 4 keys each,
+// merge buffers of budget / 2 keys for all runs together and budget / 4 keys for output
+void QuickSortMPI::externalSortRun() {
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start_time = MPI_Wtime();
+
+    MPI_File input;
+    if (MPI_File_open(MPI_COMM_WORLD, argv[1], MPI_MODE_RDONLY, MPI_INFO_NULL, &input) != MPI_SUCCESS) {
+        if (MPI_initial_rank == MAIN_PROCESS) {
+            std::cout << "can't open input file " << argv[1] << "\n";
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    SortFileHeader header{};
+    MPI_File_read_at_all(input, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+    if (memcmp(header.magic, SORT_FILE_MAGIC, sizeof(header.magic)) != 0) {
+        if (MPI_initial_rank == MAIN_PROCESS) {
+            std::cout << "wrong keys file format: " << argv[1] << "\n";
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    long long total = header.count;
+    long long first = total * MPI_initial_rank / MPI_initial_size;
+    long long last = total * (MPI_initial_rank + 1) / MPI_initial_size;
+    if (MPI_initial_rank == MAIN_PROCESS) {
+        std::cerr << total << " " << MPI_initial_size << " ";
+    }
+
+    size_t budget_keys = memory_budget / sizeof(int);
+
+    std::vector<std::string> runs;
+    std::vector<long long> run_sizes;
+    std::vector<int> samples;
+    createSortedRuns(input, first, last, budget_keys / 2, runs, run_sizes, samples);
+    MPI_File_close(&input);
+
+    std::vector<int> splitters(MPI_initial_size - 1);
+    if (MPI_initial_size > 1) {
+        selectSplitters(samples, splitters);
+    }
+
+    std::vector<std::string> received;
+    std::vector<long long> received_sizes;
+    exchangeRuns(runs, run_sizes, splitters, budget_keys / 4, received, received_sizes);
+
+    long long size = 0;
+    for (long long run_size : received_sizes) {
+        size += run_size;
+    }
+    long long offset = 0;
+    MPI_Exscan(&size, &offset, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    if (MPI_initial_rank == MAIN_PROCESS) {
+        offset = 0;
+    }
+    order = MPI_initial_rank;
+
+    MPI_File output;
+    if (MPI_File_open(MPI_COMM_WORLD, argv[2], MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &output) !=
+        MPI_SUCCESS) {
+        if (MPI_initial_rank == MAIN_PROCESS) {
+            std::cout << "can't open output file " << argv[2] << "\n";
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_File_set_size(output, 0);
+    if (MPI_initial_rank == MAIN_PROCESS) {
+        MPI_File_write_at(output, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+    mergeRunsToFile(received, received_sizes, output, sizeof(header) + offset * sizeof(int), budget_keys);
+    MPI_File_close(&output);
+
+    double end_time = MPI_Wtime();
+    if (MPI_initial_rank == MAIN_PROCESS) {
+        calc_time = end_time - start_time;
+    }
+}
+
+void QuickSortMPI::createSortedRuns(MPI_File input, long long first, long long last, size_t chunk,
+                                    std::vector<std::string> &runs, std::vector<long long> &run_sizes,
+                                    std::vector<int> &samples) {
+    int size = MPI_initial_size;
+    std::vector<int> buffer(std::min<long long>(chunk, last - first));
+    for (long long from = first; from < last; from += chunk) {
+        int count = std::min<long long>(chunk, last - from);
+        MPI_File_read_at(input, sizeof(SortFileHeader) + from * sizeof(int), buffer.data(), count, MPI_INT,
+                         MPI_STATUS_IGNORE);
+        sortKeys(buffer.data(), count);
+
+        // regular samples of every run, runs are of equal size except the last one
+        for (int i = 0; i < size; i++) {
+            samples.push_back(buffer[(long long) i * count / size]);
+        }
+
+        std::string path = runPath(runs.size());
+        FILE *file = openRun(path, "wb");
+        fwrite(buffer.data(), sizeof(int), count, file);
+        fclose(file);
+        runs.push_back(path);
+        run_sizes.push_back(count);
+    }
+}
+
+// every round each process offers what is left of its current block, split by the splitters. A receiver grants
+// at most block keys in total, an equal share to every sender first and the rest in turn from a rotating sender,
+// so skewed splitters can't make it hold more than the budget; what is not granted is offered again next round.
+// The pieces received in a round are merged into a new sorted run
+void QuickSortMPI::exchangeRuns(const std::vector<std::string> &runs, const std::vector<long long> &run_sizes,
+                                const std::vector<int> &splitters, size_t block, std::vector<std::string> &received,
+                                std::vector<long long> &received_sizes) {
+    int size = MPI_initial_size;
+    std::vector<int> send_block(block);
+    std::vector<int> recv_block(block);
+    std::vector<int> merged(block);
+    // what is left of the piece for every process in send_block
+    std::vector<int> piece_start(size);
+    std::vector<int> piece_end(size);
+    std::vector<int> offered(size);
+    std::vector<int> requested(size);
+    std::vector<int> granted(size);
+    std::vector<int> send_counts(size);
+    std::vector<int> send_displacements(size);
+    std::vector<int> recv_displacements(size);
+
+    int run = 0;
+    long long run_position = 0;
+    FILE *run_file = nullptr;
+    for (long long round = 0;; round++) {
+        bool left = false;
+        for (int process = 0; process < size; process++) {
+            left = left || piece_start[process] < piece_end[process];
+        }
+        if (!left && run < (int) runs.size()) {
+            if (run_file == nullptr) {
+                run_file = openRun(runs[run], "rb");
+            }
+            int count = std::min<long long>(block, run_sizes[run] - run_position);
+            count = fread(send_block.data(), sizeof(int), count, run_file);
+            run_position += count;
+            if (run_position == run_sizes[run]) {
+                fclose(run_file);
+                std::remove(runs[run].c_str());
+                run_file = nullptr;
+                run_position = 0;
+                run++;
+            }
+            for (int process = 0, from = 0; process < size; process++) {
+                int to = process == size - 1 ? count :
+                         std::lower_bound(send_block.begin() + from, send_block.begin() + count,
+                                          splitters[process]) - send_block.begin();
+                piece_start[process] = from;
+                piece_end[process] = to;
+                from = to;
+            }
+        }
+
+        int local_offer = 0;
+        for (int process = 0; process < size; process++) {
+            offered[process] = piece_end[process] - piece_start[process];
+            local_offer = local_offer || offered[process] > 0;
+        }
+        int any_offer;
+        MPI_Allreduce(&local_offer, &any_offer, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+        if (!any_offer) {
+            break;
+        }
+
+        MPI_Alltoall(offered.data(), 1, MPI_INT, requested.data(), 1, MPI_INT, MPI_COMM_WORLD);
+        int capacity = block;
+        for (int process = 0; process < size; process++) {
+            granted[process] = std::min<int>(requested[process], block / size);
+            capacity -= granted[process];
+        }
+        for (int i = 0; i < size && capacity > 0; i++) {
+            int process = (round + i) % size;
+            int extra = std::min(requested[process] - granted[process], capacity);
+            granted[process] += extra;
+            capacity -= extra;
+        }
+        MPI_Alltoall(granted.data(), 1, MPI_INT, send_counts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+
+        int recv_size = 0;
+        for (int process = 0; process < size; process++) {
+            send_displacements[process] = piece_start[process];
+            piece_start[process] += send_counts[process];
+            recv_displacements[process] = recv_size;
+            recv_size += granted[process];
+        }
+        MPI_Alltoallv(send_block.data(), send_counts.data(), send_displacements.data(), MPI_INT, recv_block.data(),
+                      granted.data(), recv_displacements.data(), MPI_INT, MPI_COMM_WORLD);
+
+        if (recv_size > 0) {
+            mergeRuns(recv_block.data(), granted, recv_displacements, merged.data());
+            std::string path = runPath(runs.size() + received.size());
+            FILE *file = openRun(path, "wb");
+            fwrite(merged.data(), sizeof(int), recv_size, file);
+            fclose(file);
+            received.push_back(path);
+            received_sizes.push_back(recv_size);
+        }
+    }
+}
+
+void QuickSortMPI::mergeRunsToFile(const std::vector<std::string> &runs, const std::vector<long long> &run_sizes,
+                                   MPI_File output, MPI_Offset offset, size_t budget_keys) {
+    size_t runs_count = runs.size();
+    // two buffers per run for read-ahead take half of the budget
+    size_t run_buffer = budget_keys / 4 / std::max<size_t>(runs_count, 1);
+    if (run_buffer == 0) {
+        std::cout << "memory budget of " << (memory_budget >> 20) << " MB is too small to merge " << runs_count
+                  << " runs, give more memory\n";
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    std::vector<RunReader *> readers;
+    typedef std::pair<int, int> item; // value, run
+    std::priority_queue<item, std::vector<item>, std::greater<item>> heap;
+    for (size_t run = 0; run < runs_count; run++) {
+        readers.push_back(new RunReader(runs[run], std::min<size_t>(run_buffer, run_sizes[run])));
+        if (!readers[run]->empty()) {
+            heap.push({readers[run]->top(), (int) run});
+        }
+    }
+
+    // output is written from one buffer while the other one is filled
+    size_t out_buffer = budget_keys / 8;
+    std::vector<int> out[2] = {std::vector<int>(out_buffer), std::vector<int>(out_buffer)};
+    MPI_Request write_request = MPI_REQUEST_NULL;
+    int current = 0;
+    size_t filled = 0;
+    while (!heap.empty()) {
+        item top = heap.top();
+        heap.pop();
+        out[current][filled++] = top.first;
+        RunReader *reader = readers[top.second];
+        reader->next();
+        if (!reader->empty()) {
+            heap.push({reader->top(), top.second});
+        }
+
+        if (filled == out_buffer || heap.empty()) {
+            MPI_Wait(&write_request, MPI_STATUS_IGNORE);
+            MPI_File_iwrite_at(output, offset, out[current].data(), filled, MPI_INT, &write_request);
+            offset += filled * sizeof(int);
+            current ^= 1;
+            filled = 0;
+        }
+    }
+    MPI_Wait(&write_request, MPI_STATUS_IGNORE);
+
+    for (size_t run = 0; run < runs_count; run++) {
+        delete readers[run];
+        std::remove(runs[run].c_str());
+    }
+}
@@ -0,0 +1,137 @@
+#ifndef Lab_3_LOCALSORT_H
+#define Lab_3_LOCALSORT_H
+
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+#include <type_traits>
+#include <omp.h>
+
+namespace localSort {
+    // maps signed keys to unsigned ones with the same order
+    template<typename T>
+    inline typename std::make_unsigned<T>::type radixKey(T value) {
+        typedef typename std::make_unsigned<T>::type U;
+        return (U) value ^ ((U) 1 << (sizeof(T) * 8 - 1));
+    }
+
+    // comparator can't be inlined through qsort, kept for comparison only
+    inline void cQuickSort(int *data, int size) {
+        std::qsort(data, size, sizeof(int), [](const void *p1, const void *p2) {
+            int a = *(const int *) p1;
+            int b = *(const int *) p2;
+            return (a > b) - (a < b);
+        });
+    }
+
+    // std::sort is an introsort, with the default comparator it is fully inlined
+    template<typename T>
+    void introSort(T *data, size_t size) {
+        std::sort(data, data + size);
+    }
+
+    // lsd radix sort on bytes, passes where all keys share the byte are skipped
+    template<typename T>
+    void radixSort(T *data, size_t size) {
+        static const int RADIX = 256;
+        static const size_t SMALL = 64;
+        if (size < SMALL) {
+            introSort(data, size);
+            return;
+        }
+
+        std::vector<size_t> counts(sizeof(T) * RADIX, 0);
+        for (size_t i = 0; i < size; i++) {
+            auto key = radixKey(data[i]);
+            for (size_t byte = 0; byte < sizeof(T); byte++) {
+                counts[byte * RADIX + ((key >> (byte * 8)) & 0xFF)]++;
+            }
+        }
+
+        std::vector<T> buffer(size);
+        T *from = data;
+        T *to = buffer.data();
+        for (size_t byte = 0; byte < sizeof(T); byte++) {
+            size_t *count = counts.data() + byte * RADIX;
+            if (count[(radixKey(from[0]) >> (byte * 8)) & 0xFF] == size) {
+                continue;
+            }
+            for (size_t digit = 0, offset = 0; digit < RADIX; digit++) {
+                size_t current = count[digit];
+                count[digit] = offset;
+                offset += current;
+            }
+            for (size_t i = 0; i < size; i++) {
+                to[count[(radixKey(from[i]) >> (byte * 8)) & 0xFF]++] = from[i];
+            }
+            std::swap(from, to);
+        }
+        if (from != data) {
+            memcpy(data, from, size * sizeof(T));
+        }
+    }
+
+    // lsd radix sort where every thread histograms and scatters its own contiguous block
+    template<typename T>
+    void parallelRadixSort(T *data, size_t size) {
+        static const int RADIX = 256;
+        int threads = omp_get_max_threads();
+        if (threads == 1 || size < (size_t) threads * 4096) {
+            radixSort(data, size);
+            return;
+        }
+
+        std::vector<T> buffer(size);
+        std::vector<size_t> counts((size_t) threads * RADIX);
+        T *from = data;
+        T *to = buffer.data();
+
+        for (size_t byte = 0; byte < sizeof(T); byte++) {
+            int shift = byte * 8;
+            bool skip = false;
+#pragma omp parallel num_threads(threads)
+            {
+                int thread = omp_get_thread_num();
+                size_t first = size * thread / threads;
+                size_t last = size * (thread + 1) / threads;
+                size_t *count = counts.data() + (size_t) thread * RADIX;
+                std::fill(count, count + RADIX, 0);
+                for (size_t i = first; i < last; i++) {
+                    count[(radixKey(from[i]) >> shift) & 0xFF]++;
+                }
+#pragma omp barrier
+#pragma omp single
+                {
+                    // offsets go digit by digit, inside a digit thread by thread, so the sort stays stable
+                    size_t offset = 0;
+                    for (int digit = 0; digit < RADIX; digit++) {
+                        size_t digit_start = offset;
+                        for (int t = 0; t < threads; t++) {
+                            size_t current = counts[(size_t) t * RADIX + digit];
+                            counts[(size_t) t * RADIX + digit] = offset;
+                            offset += current;
+                        }
+                        // every key has this digit, the pass would only copy
+                        if (offset - digit_start == size) {
+                            skip = true;
+                        }
+                    }
+                }
+                if (!skip) {
+                    for (size_t i = first; i < last; i++) {
+                        to[count[(radixKey(from[i]) >> shift) & 0xFF]++] = from[i];
+                    }
+                }
+            }
+            if (!skip) {
+                std::swap(from, to);
+            }
+        }
+        if (from != data) {
+            memcpy(data, from, size * sizeof(T));
+        }
+    }
+}
+
+#endif
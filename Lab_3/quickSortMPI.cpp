@@ -1,8 +1,11 @@
 #include "quickSortMPI.h"
+#include "localSort.h"
+#include "perfCountersMPI.h"
 #include <iostream>
 #include <random>
 #include <algorithm>
 #include <cstring>
+#include <sstream>
 
 void readInitial(ld *&init, const std::string &path) {
     std::ifstream in(path);
@@ -45,15 +48,29 @@ QuickSortMPI::QuickSortMPI(int argc, char **argv) {
 QuickSortMPI::~QuickSortMPI() {
     delete[] full_array;
     delete[] array_working_part;
+    delete[] spare_array;
+    freeCommunicators();
     stopMPI();
 }
 
 void QuickSortMPI::prepareMPI() {
-    MPI_Init(&argc, &argv);
+    // benchmark initialises MPI itself and sorts with several instances
+    int initialized;
+    MPI_Initialized(&initialized);
+    if (initialized) {
+        return;
+    }
+    // helper threads (OpenMP local sort, read-ahead of the external sort) never call MPI
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    owns_mpi = true;
 }
 
 void QuickSortMPI::stopMPI() {
-    MPI_Finalize();
+    if (owns_mpi) {
+        perf::reportMPI(MPI_COMM_WORLD, MAIN_PROCESS, std::cerr);
+        MPI_Finalize();
+    }
 }
 
 double QuickSortMPI::run() {
@@ -61,18 +78,55 @@ double QuickSortMPI::run() {
     MPI_Comm_size(MPI_COMM_WORLD, &MPI_initial_size);
     MPI_Comm_rank(MPI_COMM_WORLD, &MPI_initial_rank);
 
-    if (__builtin_popcount(MPI_initial_size) != 1) {
-        std::cout << "number of processes should be power of two.\n";
+    if (argc < 3) {
+        if (MPI_initial_rank == MAIN_PROCESS) {
+            std::cout << "usage: path1 path2 [options]\n"
+                         "path1 - path to file which data has to be sorted,\n"
+                         "path2 - path to write sorted data,\n"
+                         "options:\n"
+                         "--engine=hypercube - recursive hypercube quicksort (default),\n"
+                         "--engine=psrs - parallel sorting by regular sampling: one all-to-all exchange,\n"
+                         "--pivot=sample - weighted quantile of random samples of all processes (default),\n"
+                         "--pivot=medians - weighted median of local medians,\n"
+                         "--pivot=random - quantile of a sample of the group root's keys only,\n"
+                         "--local-sort=introsort - std::sort for the local phase (default),\n"
+                         "--local-sort=radix - lsd radix sort,\n"
+                         "--local-sort=parallel-radix - lsd radix sort on all OpenMP threads of the process,\n"
+                         "--local-sort=qsort - std::qsort,\n"
+                         "--binary-output - every process writes its sorted part straight to path2\n"
+                         "                  (binary: header and int32 keys) instead of gathering on one process,\n"
+                         "--stats - print load imbalance after every hypercube level,\n"
+                         "--engine=external - out-of-core sort of a binary path1 into a binary path2,\n"
+                         "--memory=MB - memory budget per process for the external sort (default 256),\n"
+                         "--temp-dir=path - directory for sorted runs of the external sort (default /tmp),\n"
+                         "--to-binary - convert text path1 to a binary keys file path2 and exit,\n"
+                         "--select=k - write only the k-th smallest key to path2, nothing is sorted or moved,\n"
+                         "--top=k - write the k smallest keys to path2,\n"
+                         "--quantiles=q1,q2,... - write the keys at the given fractions (0..1) to path2,\n";
+        }
         exit(0);
     }
+    readOptions();
 
-    if(MPI_initial_rank == MAIN_PROCESS){
-        if (argc < 3) {
-            std::cout << "usage: path1 path2\n"
-                         "path1 - path to file which data has to be sorted,\n"
-                         "path2 - path to write sorted data,\n";
-            exit(0);
+    if (to_binary) {
+        if (MPI_initial_rank == MAIN_PROCESS) {
+            readInitialData();
+            writeInitialBinary();
         }
+        return calc_time;
+    }
+
+    if (engine == EXTERNAL_SORT) {
+        externalSortRun();
+        return calc_time;
+    }
+
+    if (query != NO_QUERY) {
+        queryRun();
+        return calc_time;
+    }
+
+    if(MPI_initial_rank == MAIN_PROCESS){
         mainProcessRun();
     } else {
         otherProcessRun();
@@ -84,72 +138,440 @@ void QuickSortMPI::mainProcessRun() {
     readInitialData();
     // calculation starts
     double start_time = MPI_Wtime();
-    sendInitialData();
-    copyInitialData();
-    startSolve(MPI_COMM_WORLD);
-    recvResult();
+    distributeAndSort();
     double end_time = MPI_Wtime();
     calc_time = end_time - start_time;
-    writeResult();
+    if (!binary_output) {
+        writeResult();
+    }
 }
 
 void QuickSortMPI::otherProcessRun() {
-    waitInitialData();
-    startSolve(MPI_COMM_WORLD);
-    sendResult();
+    distributeAndSort();
+}
+
+void QuickSortMPI::distributeAndSort() {
+    std::fill(phase_time, phase_time + PHASES, 0.0);
+    double start_time = MPI_Wtime();
+    if (MPI_initial_rank == MAIN_PROCESS) {
+        sendInitialData();
+        copyInitialData();
+    } else {
+        waitInitialData();
+    }
+    phase_time[DISTRIBUTION] = MPI_Wtime() - start_time;
+
+    solve();
+
+    start_time = MPI_Wtime();
+    if (binary_output) {
+        writeResultParallel();
+    } else if (MPI_initial_rank == MAIN_PROCESS) {
+        recvResult();
+    } else {
+        sendResult();
+    }
+    phase_time[GATHER] = MPI_Wtime() - start_time;
 }
 
-void QuickSortMPI::startSolve(MPI_Comm current_communicator) {
+double QuickSortMPI::sortInMemory(std::vector<int> &keys) {
+    MPI_Comm_size(MPI_COMM_WORLD, &MPI_initial_size);
+    MPI_Comm_rank(MPI_COMM_WORLD, &MPI_initial_rank);
+    readOptions();
+    if (MPI_initial_rank == MAIN_PROCESS) {
+        delete[] full_array;
+        full_array_size = keys.size();
+        full_array = new int[full_array_size];
+        memcpy(full_array, keys.data(), full_array_size * sizeof(int));
+    }
 
-    int cur_size;
-    int cur_rank;
-    MPI_Comm_rank(current_communicator, &cur_rank);
-    MPI_Comm_size(current_communicator, &cur_size);
-    bool main_process = cur_rank == MAIN_PROCESS;
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start_time = MPI_Wtime();
+    distributeAndSort();
+    double end_time = MPI_Wtime();
 
-    if (cur_size == 1) {
-        quickSort(0, array_size);
+    if (MPI_initial_rank == MAIN_PROCESS) {
+        memcpy(keys.data(), full_array, full_array_size * sizeof(int));
+    }
+    return end_time - start_time;
+}
 
+void QuickSortMPI::phaseSummary(std::vector<double> &max_values, std::vector<double> &avg_values) {
+    std::vector<double> local(phase_time, phase_time + PHASES);
+    local.push_back(array_size);
+    max_values.resize(local.size());
+    avg_values.resize(local.size());
+    MPI_Reduce(local.data(), max_values.data(), local.size(), MPI_DOUBLE, MPI_MAX, MAIN_PROCESS, MPI_COMM_WORLD);
+    MPI_Reduce(local.data(), avg_values.data(), local.size(), MPI_DOUBLE, MPI_SUM, MAIN_PROCESS, MPI_COMM_WORLD);
+    for (double &value : avg_values) {
+        value /= MPI_initial_size;
+    }
+}
+
+void QuickSortMPI::readOptions() {
+    for (int i = 3; i < argc; i++) {
+        std::string option = argv[i];
+        if (option == "--engine=hypercube") {
+            engine = HYPERCUBE;
+        } else if (option == "--engine=psrs") {
+            engine = SAMPLE_SORT;
+        } else if (option == "--pivot=sample") {
+            pivot_strategy = SAMPLE_PIVOT;
+        } else if (option == "--pivot=medians") {
+            pivot_strategy = MEDIANS_PIVOT;
+        } else if (option == "--pivot=random") {
+            pivot_strategy = RANDOM_PIVOT;
+        } else if (option == "--local-sort=introsort") {
+            local_sort = INTRO_SORT;
+        } else if (option == "--local-sort=radix") {
+            local_sort = RADIX_SORT;
+        } else if (option == "--local-sort=parallel-radix") {
+            local_sort = PARALLEL_RADIX_SORT;
+        } else if (option == "--local-sort=qsort") {
+            local_sort = C_QSORT;
+        } else if (option == "--binary-output") {
+            binary_output = true;
+        } else if (option == "--engine=external") {
+            engine = EXTERNAL_SORT;
+        } else if (option.compare(0, 9, "--memory=") == 0) {
+            memory_budget = std::max(1LL, atoll(option.c_str() + 9)) << 20;
+        } else if (option.compare(0, 11, "--temp-dir=") == 0) {
+            temp_dir = option.substr(11);
+        } else if (option == "--to-binary") {
+            to_binary = true;
+        } else if (option.compare(0, 9, "--select=") == 0) {
+            query = KTH_QUERY;
+            query_k = atoll(option.c_str() + 9);
+        } else if (option.compare(0, 6, "--top=") == 0) {
+            query = TOP_QUERY;
+            query_k = atoll(option.c_str() + 6);
+        } else if (option.compare(0, 12, "--quantiles=") == 0) {
+            query = QUANTILES_QUERY;
+            quantiles.clear();
+            std::stringstream list(option.substr(12));
+            std::string value;
+            while (std::getline(list, value, ',')) {
+                quantiles.push_back(atof(value.c_str()));
+            }
+        } else if (option == "--stats") {
+            print_stats = true;
+        } else if (MPI_initial_rank == MAIN_PROCESS) {
+            std::cout << "unknown option: " << option << "\n";
+        }
+    }
+}
+
+void QuickSortMPI::solve() {
+    switch (engine) {
+        case SAMPLE_SORT:
+            startSampleSort();
+            break;
+        default:
+            startSolve();
+            break;
+    }
+    if (print_stats) {
+        reportImbalance();
+    }
+}
+
+void QuickSortMPI::startSolve() {
+    buildCommunicators();
+    order = 0;
+
+    double start_time = MPI_Wtime();
+    for (MPI_Comm current_communicator : communicators) {
+        int cur_size;
+        int cur_rank;
+        MPI_Comm_rank(current_communicator, &cur_rank);
+        MPI_Comm_size(current_communicator, &cur_size);
+
+        if (cur_size == 1) {
+            break;
+        }
+
+        // low half of processes takes keys below the pivot, so for odd sizes
+        // the pivot has to split the data in the same proportion as the processes
+        int low_size = cur_size / 2;
+        bool high = cur_rank >= low_size;
+
+        int pivot = choosePivot(low_size, cur_size, current_communicator);
+        rearrangePart(pivot);
+        splitTies(low_size, cur_size, current_communicator);
+        updateArr(cur_rank, cur_size, current_communicator);
+        if (print_stats) {
+            recordImbalance(current_communicator);
+        }
+
+        if (high) {
+            order += low_size;
+        }
+    }
+    phase_time[PARTITION] += MPI_Wtime() - start_time;
+
+    start_time = MPI_Wtime();
+    quickSort(0, array_size);
+    phase_time[LOCAL_SORT] += MPI_Wtime() - start_time;
+}
+
+// the halves of every hypercube level depend only on the process count, so they are split once
+void QuickSortMPI::buildCommunicators() {
+    if (!communicators.empty()) {
         return;
     }
+    MPI_Comm current_communicator = MPI_COMM_WORLD;
+    communicators.push_back(current_communicator);
+    while (true) {
+        int cur_size;
+        int cur_rank;
+        MPI_Comm_rank(current_communicator, &cur_rank);
+        MPI_Comm_size(current_communicator, &cur_size);
+        if (cur_size == 1) {
+            break;
+        }
+        MPI_Comm new_comm;
+        MPI_Comm_split(current_communicator, cur_rank >= cur_size / 2, 0, &new_comm);
+        communicators.push_back(new_comm);
+        current_communicator = new_comm;
+    }
+}
 
-    int pivot;
-    if (main_process) {
-        pivot = getPivot(0, array_size);
+void QuickSortMPI::freeCommunicators() {
+    for (MPI_Comm &communicator : communicators) {
+        if (communicator != MPI_COMM_WORLD) {
+            MPI_Comm_free(&communicator);
+        }
     }
-    broadcastPivot(pivot, current_communicator);
-    rearrangePart(pivot);
-    updateArr(cur_rank, current_communicator);
+    communicators.clear();
+}
 
-    MPI_Comm new_comm;
-    MPI_Comm_split(current_communicator, cur_rank & 1, 0, &new_comm);
+int *QuickSortMPI::reserveSpare(int size) {
+    if (spare_capacity < size) {
+        delete[] spare_array;
+        spare_capacity = std::max(size, spare_capacity + spare_capacity / 2);
+        spare_array = new int[spare_capacity];
+    }
+    return spare_array;
+}
 
-    order = 2 * order + (cur_rank & 1);
-    startSolve(new_comm);
+void QuickSortMPI::swapBuffers(int new_size) {
+    std::swap(array_working_part, spare_array);
+    std::swap(working_capacity, spare_capacity);
+    array_size = new_size;
 }
 
+// three-way partition: [0, less_end) < pivot, [less_end, equal_end) == pivot, [equal_end, array_size) > pivot
 void QuickSortMPI::rearrangePart(int pivot) {
-    int i, j;
-    for (i = 0, j = array_size - 1; i < j;) {
-        while (i < j && array_working_part[i] < pivot) i++;
-        while (i < j && array_working_part[j] >= pivot) j--;
-        std::swap(array_working_part[i], array_working_part[j]);
+    PERF_REGION("rearrangePart");
+    auto bounds = partitionRange(array_working_part, array_size, pivot);
+    less_end = bounds.first;
+    equal_end = bounds.second;
+    split_pos = less_end;
+}
+
+std::pair<int, int> QuickSortMPI::partitionRange(int *data, int size, int pivot) {
+    int i = 0;
+    int less = 0;
+    int greater = size;
+    while (i < greater) {
+        if (data[i] < pivot) {
+            std::swap(data[less++], data[i++]);
+        } else if (data[i] > pivot) {
+            std::swap(data[i], data[--greater]);
+        } else {
+            i++;
+        }
+    }
+    return {less, greater};
+}
+
+// keys equal to the pivot may go to either half, so they are used to even out the halves
+void QuickSortMPI::splitTies(int low_size, int cur_size, MPI_Comm current_communicator) {
+    long long local[] = {less_end, equal_end - less_end, array_size};
+    long long global[3];
+    MPI_Allreduce(local, global, 3, MPI_LONG_LONG, MPI_SUM, current_communicator);
+
+    long long target = global[2] * low_size / cur_size;
+    long long equal_low = std::max(0LL, std::min(target - global[0], global[1]));
+
+    long long equal_before = 0;
+    MPI_Exscan(&local[1], &equal_before, 1, MPI_LONG_LONG, MPI_SUM, current_communicator);
+    int cur_rank;
+    MPI_Comm_rank(current_communicator, &cur_rank);
+    if (cur_rank == MAIN_PROCESS) {
+        equal_before = 0;
+    }
+    split_pos = less_end + (int) std::max(0LL, std::min(equal_low - equal_before, local[1]));
+}
+
+int QuickSortMPI::choosePivot(int low_size, int cur_size, MPI_Comm current_communicator) {
+    double fraction = (double) low_size / cur_size;
+    int pivot = 0;
+    int cur_rank;
+    MPI_Comm_rank(current_communicator, &cur_rank);
+
+    switch (pivot_strategy) {
+        case RANDOM_PIVOT: {
+            if (cur_rank == MAIN_PROCESS) {
+                pivot = getPivot(0, array_size, fraction);
+            }
+            broadcastPivot(pivot, current_communicator);
+            break;
+        }
+        case MEDIANS_PIVOT: {
+            // weighted median of the local quantiles, weights are the part sizes
+            int local[] = {0, array_size};
+            if (array_size > 0) {
+                int *position = array_working_part + (int) (fraction * (array_size - 1));
+                std::nth_element(array_working_part, position, array_working_part + array_size);
+                local[0] = *position;
+            }
+            std::vector<int> all(2 * cur_size);
+            MPI_Allgather(local, 2, MPI_INT, all.data(), 2, MPI_INT, current_communicator);
+            std::vector<std::pair<int, double>> weighted(cur_size);
+            for (int process = 0; process < cur_size; process++) {
+                weighted[process] = {all[2 * process], all[2 * process + 1]};
+            }
+            pivot = weightedQuantile(weighted, fraction);
+            break;
+        }
+        case SAMPLE_PIVOT: {
+            pivot = sampledQuantile(array_working_part, array_size, fraction, current_communicator);
+            break;
+        }
+    }
+    return pivot;
+}
+
+// weighted quantile of random samples of all processes, every sample stands for size / sample_count keys
+int QuickSortMPI::sampledQuantile(const int *data, int size, double fraction, MPI_Comm communicator) {
+    static const int SAMPLE_SIZE = 64;
+    int cur_size;
+    MPI_Comm_size(communicator, &cur_size);
+
+    std::random_device rd;
+    std::default_random_engine generator(rd());
+    std::uniform_int_distribution<int> distribution(0, std::max(0, size - 1));
+    int sample_count = std::min(SAMPLE_SIZE, size);
+    std::vector<int> sample(sample_count);
+    for (int &value : sample) {
+        value = data[distribution(generator)];
+    }
+
+    int local[] = {sample_count, size};
+    std::vector<int> all(2 * cur_size);
+    MPI_Allgather(local, 2, MPI_INT, all.data(), 2, MPI_INT, communicator);
+    std::vector<int> counts(cur_size);
+    std::vector<int> displacements(cur_size);
+    int total = 0;
+    for (int process = 0; process < cur_size; process++) {
+        counts[process] = all[2 * process];
+        displacements[process] = total;
+        total += counts[process];
+    }
+    std::vector<int> samples(total);
+    MPI_Allgatherv(sample.data(), sample_count, MPI_INT, samples.data(), counts.data(), displacements.data(),
+                   MPI_INT, communicator);
+
+    std::vector<std::pair<int, double>> weighted(total);
+    for (int process = 0; process < cur_size; process++) {
+        for (int i = 0; i < counts[process]; i++) {
+            weighted[displacements[process] + i] = {samples[displacements[process] + i],
+                                                    (double) all[2 * process + 1] / counts[process]};
+        }
+    }
+    return weightedQuantile(weighted, fraction);
+}
+
+int QuickSortMPI::weightedQuantile(std::vector<std::pair<int, double>> &values, double fraction) {
+    std::sort(values.begin(), values.end());
+    double total = 0;
+    for (auto &value : values) {
+        total += value.second;
+    }
+    double accumulated = 0;
+    for (auto &value : values) {
+        accumulated += value.second;
+        if (accumulated > fraction * total) {
+            return value.first;
+        }
+    }
+    return values.empty() ? 0 : values.back().first;
+}
+
+void QuickSortMPI::recordImbalance(MPI_Comm communicator) {
+    int cur_size;
+    MPI_Comm_size(communicator, &cur_size);
+    long long local = array_size;
+    long long max_size;
+    long long sum_size;
+    MPI_Allreduce(&local, &max_size, 1, MPI_LONG_LONG, MPI_MAX, communicator);
+    MPI_Allreduce(&local, &sum_size, 1, MPI_LONG_LONG, MPI_SUM, communicator);
+    level_imbalance.push_back(sum_size == 0 ? 1 : (double) max_size * cur_size / sum_size);
+}
+
+void QuickSortMPI::reportImbalance() {
+    static const int MAX_LEVELS = 32;
+    // groups of one level may have different depth for odd sizes, so levels are padded
+    std::vector<double> local(MAX_LEVELS, 0);
+    for (int level = 0; level < (int) level_imbalance.size() && level < MAX_LEVELS; level++) {
+        local[level] = level_imbalance[level];
+    }
+    std::vector<double> worst(MAX_LEVELS);
+    MPI_Reduce(local.data(), worst.data(), MAX_LEVELS, MPI_DOUBLE, MPI_MAX, MAIN_PROCESS, MPI_COMM_WORLD);
+
+    long long size = array_size;
+    long long max_size;
+    long long sum_size;
+    MPI_Reduce(&size, &max_size, 1, MPI_LONG_LONG, MPI_MAX, MAIN_PROCESS, MPI_COMM_WORLD);
+    MPI_Reduce(&size, &sum_size, 1, MPI_LONG_LONG, MPI_SUM, MAIN_PROCESS, MPI_COMM_WORLD);
+
+    if (MPI_initial_rank == MAIN_PROCESS) {
+        for (int level = 0; level < MAX_LEVELS && worst[level] > 0; level++) {
+            std::cout << "level " << level << ": max / avg part size in worst group " << worst[level] << "\n";
+        }
+        std::cout << "final: max / avg part size " << (sum_size == 0 ? 1 : (double) max_size * MPI_initial_size /
+                                                                          sum_size) << "\n";
     }
-    split_pos = i;
 }
 
 void QuickSortMPI::quickSort(int from, int to) {
-    std::qsort(array_working_part, to - from, sizeof(int),
-               [](const void *p1, const void *p2) { return *(int *) p1 - *(int *) p2; }
-    );
+    sortKeys(array_working_part + from, to - from);
+}
+
+void QuickSortMPI::sortKeys(int *data, int size) {
+    PERF_REGION("sortKeys");
+    switch (local_sort) {
+        case C_QSORT:
+            localSort::cQuickSort(data, size);
+            break;
+        case RADIX_SORT:
+            localSort::radixSort(data, size);
+            break;
+        case PARALLEL_RADIX_SORT:
+            localSort::parallelRadixSort(data, size);
+            break;
+        default:
+            localSort::introSort(data, size);
+            break;
+    }
 }
 
-int QuickSortMPI::getPivot(int from, int to) {
+int QuickSortMPI::getPivot(int from, int to, double fraction) {
+    static const int SAMPLE_SIZE = 31;
+    if (to <= from) {
+        return 0;
+    }
     std::random_device rd;
     std::default_random_engine generator(rd());
     std::uniform_int_distribution<int> distribution(from, to - 1);
-    int rand_index = distribution(generator);
-    return array_working_part[rand_index];
+    std::vector<int> sample(std::min(SAMPLE_SIZE, to - from));
+    for (int &value : sample) {
+        value = array_working_part[distribution(generator)];
+    }
+    auto position = sample.begin() + (int) (fraction * sample.size());
+    std::nth_element(sample.begin(), position, sample.end());
+    return *position;
 }
 
 void QuickSortMPI::writeResult() {
@@ -161,6 +583,49 @@ void QuickSortMPI::writeResult() {
     out << "\n";
 }
 
+void QuickSortMPI::writeResultParallel() {
+    // processes ranked by order hold consecutive pieces of the result
+    MPI_Comm ordered;
+    MPI_Comm_split(MPI_COMM_WORLD, 0, order, &ordered);
+    int ordered_rank;
+    MPI_Comm_rank(ordered, &ordered_rank);
+    long long size = array_size;
+    long long offset = 0;
+    MPI_Exscan(&size, &offset, 1, MPI_LONG_LONG, MPI_SUM, ordered);
+    if (ordered_rank == 0) {
+        offset = 0;
+    }
+
+    MPI_File file;
+    if (MPI_File_open(ordered, argv[2], MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+        if (MPI_initial_rank == MAIN_PROCESS) {
+            std::cout << "can't open output file " << argv[2] << "\n";
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_File_set_size(file, 0);
+
+    if (MPI_initial_rank == MAIN_PROCESS) {
+        SortFileHeader header{};
+        memcpy(header.magic, SORT_FILE_MAGIC, sizeof(header.magic));
+        header.count = full_array_size;
+        MPI_File_write_at(file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+    MPI_File_write_at_all(file, sizeof(SortFileHeader) + offset * sizeof(int), array_working_part, array_size, MPI_INT,
+                          MPI_STATUS_IGNORE);
+    MPI_File_close(&file);
+    MPI_Comm_free(&ordered);
+}
+
+void QuickSortMPI::writeInitialBinary() {
+    std::ofstream out(argv[2], std::ios::binary | std::ios::trunc);
+    SortFileHeader header{};
+    memcpy(header.magic, SORT_FILE_MAGIC, sizeof(header.magic));
+    header.count = full_array_size;
+    out.write((const char *) &header, sizeof(header));
+    out.write((const char *) full_array, (std::streamsize) full_array_size * sizeof(int));
+}
+
 void QuickSortMPI::printInfo() {
     log << "rank: " << MPI_initial_rank << " - started" << std::endl;
     log << "array_working_part size: " << array_size << std::endl;
@@ -198,7 +663,9 @@ void QuickSortMPI::sendInitialData() {
 
 void QuickSortMPI::waitInitialData() {
     MPI_Recv(&array_size, 1, MPI_INT, MAIN_PROCESS, SIZE, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    delete[] array_working_part;
     array_working_part = new int[array_size];
+    working_capacity = array_size;
     MPI_Recv(array_working_part, array_size, MPI_INT, MAIN_PROCESS, INIT, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
 }
 
@@ -207,7 +674,9 @@ void QuickSortMPI::copyInitialData() {
     int first = MPI_initial_rank * part_size;
     int last = (MAIN_PROCESS == MPI_initial_size - 1 ? full_array_size : first + part_size);
     array_size = last - first;
+    delete[] array_working_part;
     array_working_part = new int[array_size];
+    working_capacity = array_size;
     memcpy(array_working_part, full_array, array_size * sizeof(int));
 }
 
@@ -215,47 +684,62 @@ void QuickSortMPI::broadcastPivot(int &pivot, MPI_Comm current_communicator) {
     MPI_Bcast(&pivot, 1, MPI_INT, MAIN_PROCESS, current_communicator);
 }
 
-void QuickSortMPI::updateArr(int rank, MPI_Comm communicator) {
-    int neighbour_diff = 1;
-    bool high = rank & neighbour_diff;
+void QuickSortMPI::updateArr(int rank, int size, MPI_Comm communicator) {
+    int low_size = size / 2;
+    bool high = rank >= low_size;
     int send_size;
     int neighbour;
     int copy_from;
     int copy_to;
     int send_from;
+    int senders[2];
+    int senders_count = 0;
 
+    // every process sends the keys of the other half to one partner there.
+    // for odd sizes the last high process has no partner and sends to the last low process
     if (high) {
-        neighbour = rank - neighbour_diff;
+        neighbour = std::min(rank - low_size, low_size - 1);
         send_size = split_pos;
         send_from = 0;
         copy_from = split_pos;
         copy_to = array_size;
+        if (rank - low_size < low_size) {
+            senders[senders_count++] = rank - low_size;
+        }
     } else {
-        neighbour = rank + neighbour_diff;
+        neighbour = rank + low_size;
         send_size = array_size - split_pos;
         send_from = split_pos;
         copy_from = 0;
         copy_to = split_pos;
+        senders[senders_count++] = rank + low_size;
+        if (size % 2 == 1 && rank == low_size - 1) {
+            senders[senders_count++] = size - 1;
+        }
     }
 
-    MPI_Request reqs[3];
-
-    MPI_Isend(&send_size, 1, MPI_INT, neighbour, SIZE, communicator, &reqs[0]);
-    MPI_Isend(array_working_part + send_from, send_size, MPI_INT, neighbour, ARRAY, communicator, &reqs[1]);
-
-    int recv_size;
-    MPI_Recv(&recv_size, 1, MPI_INT, neighbour, SIZE, communicator, MPI_STATUS_IGNORE);
+    // sizes are not sent separately, the receiver takes them from the probed message
+    MPI_Request request;
+    MPI_Isend(array_working_part + send_from, send_size, MPI_INT, neighbour, ARRAY, communicator, &request);
+
+    int recv_sizes[2];
+    int recv_size = 0;
+    for (int i = 0; i < senders_count; i++) {
+        MPI_Status status;
+        MPI_Probe(senders[i], ARRAY, communicator, &status);
+        MPI_Get_count(&status, MPI_INT, &recv_sizes[i]);
+        recv_size += recv_sizes[i];
+    }
 
-    int *temp_array = new int[recv_size + array_size - send_size];
-    MPI_Irecv(temp_array, recv_size, MPI_INT, neighbour, ARRAY, communicator, &reqs[2]);
-    for (int i = copy_from; i < copy_to; i++) {
-        temp_array[i - copy_from + recv_size] = array_working_part[i];
+    int keep_size = copy_to - copy_from;
+    int *temp_array = reserveSpare(recv_size + keep_size);
+    for (int i = 0, offset = 0; i < senders_count; offset += recv_sizes[i], i++) {
+        MPI_Recv(temp_array + offset, recv_sizes[i], MPI_INT, senders[i], ARRAY, communicator, MPI_STATUS_IGNORE);
     }
+    memcpy(temp_array + recv_size, array_working_part + copy_from, keep_size * sizeof(int));
 
-    MPI_Waitall(3, reqs, MPI_STATUSES_IGNORE); // have to wait all send operations or buffers may corrupt
-    delete[] array_working_part;
-    array_working_part = temp_array;
-    array_size += recv_size - send_size;
+    MPI_Wait(&request, MPI_STATUS_IGNORE); // have to wait send operation or buffer may corrupt
+    swapBuffers(recv_size + keep_size);
 }
 
 void QuickSortMPI::recvResult() {
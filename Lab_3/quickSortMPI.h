@@ -5,9 +5,18 @@
 #include "mpi.h"
 #include <string>
 #include <fstream>
+#include <cstdint>
 
 typedef long double ld;
 
+static const char SORT_FILE_MAGIC[8] = {'Q', 'S', 'O', 'R', 'T', 'I', '3', '2'};
+
+// binary keys file: header followed by count int32 keys
+struct SortFileHeader {
+    char magic[8];
+    int64_t count;
+};
+
 class QuickSortMPI {
 public:
     QuickSortMPI(int argc, char **argv);
@@ -16,12 +25,53 @@ public:
 
     double run();
 
+    enum phases {
+        DISTRIBUTION,
+        PARTITION,
+        LOCAL_SORT,
+        GATHER,
+        PHASES,
+    };
+
+    // sorts keys of the main process without any file io, keys get the result there
+    double sortInMemory(std::vector<int> &keys);
+
+    // collective, max and average over processes of the last phase times followed by the part size,
+    // valid on the main process
+    void phaseSummary(std::vector<double> &max_values, std::vector<double> &avg_values);
+
 private:
 
     enum consts {
         MAIN_PROCESS = 0,
     };
 
+    enum engines {
+        HYPERCUBE,
+        SAMPLE_SORT,
+        EXTERNAL_SORT,
+    };
+
+    enum pivots {
+        RANDOM_PIVOT,
+        MEDIANS_PIVOT,
+        SAMPLE_PIVOT,
+    };
+
+    enum localSorts {
+        INTRO_SORT,
+        RADIX_SORT,
+        PARALLEL_RADIX_SORT,
+        C_QSORT,
+    };
+
+    enum queries {
+        NO_QUERY,
+        KTH_QUERY,
+        TOP_QUERY,
+        QUANTILES_QUERY,
+    };
+
     enum tags {
         ARRAY,
         SIZE,
@@ -35,9 +85,29 @@ private:
     int MPI_initial_rank;
     int *array_working_part = nullptr;
     int array_size = 0;
+    int working_capacity = 0;
+    int *spare_array = nullptr;
+    int spare_capacity = 0;
+    std::vector<MPI_Comm> communicators;
     int split_pos = 0;
+    int less_end = 0;
+    int equal_end = 0;
     double calc_time = -1;
+    double phase_time[PHASES] = {};
+    bool owns_mpi = false;
     int order = 0;
+    engines engine = HYPERCUBE;
+    pivots pivot_strategy = SAMPLE_PIVOT;
+    localSorts local_sort = INTRO_SORT;
+    bool print_stats = false;
+    bool binary_output = false;
+    bool to_binary = false;
+    long long memory_budget = 256LL << 20;
+    std::string temp_dir = "/tmp";
+    queries query = NO_QUERY;
+    long long query_k = 0;
+    std::vector<double> quantiles;
+    std::vector<double> level_imbalance;
 
     int argc;
     char **argv;
@@ -46,9 +116,50 @@ private:
 
     void readInitialData();
 
+    void readOptions();
+
+    void solve();
+
+    void startSampleSort();
+
+    void selectSplitters(const std::vector<int> &samples, std::vector<int> &splitters);
+
+    void splitEqualKeys(const std::vector<int> &splitters, std::vector<int> &cuts);
+
+    void mergeRuns(const int *runs, const std::vector<int> &counts, const std::vector<int> &displacements,
+                   int *merged);
+
     void rearrangePart(int pivot);
 
-    void startSolve(MPI_Comm current_communicator);
+    static std::pair<int, int> partitionRange(int *data, int size, int pivot);
+
+    int sampledQuantile(const int *data, int size, double fraction, MPI_Comm communicator);
+
+    void queryRun();
+
+    int selectKth(long long k);
+
+    std::vector<int> selectSmallest(long long k);
+
+    void splitTies(int low_size, int cur_size, MPI_Comm current_communicator);
+
+    int choosePivot(int low_size, int cur_size, MPI_Comm current_communicator);
+
+    static int weightedQuantile(std::vector<std::pair<int, double>> &values, double fraction);
+
+    void recordImbalance(MPI_Comm communicator);
+
+    void reportImbalance();
+
+    void startSolve();
+
+    void buildCommunicators();
+
+    void freeCommunicators();
+
+    int *reserveSpare(int size);
+
+    void swapBuffers(int new_size);
 
     void printInfo();
 
@@ -60,8 +171,29 @@ private:
 
     void otherProcessRun();
 
+    void distributeAndSort();
+
     void writeResult();
 
+    void writeResultParallel();
+
+    void writeInitialBinary();
+
+    void externalSortRun();
+
+    void createSortedRuns(MPI_File input, long long first, long long last, size_t chunk,
+                          std::vector<std::string> &runs, std::vector<long long> &run_sizes,
+                          std::vector<int> &samples);
+
+    void exchangeRuns(const std::vector<std::string> &runs, const std::vector<long long> &run_sizes,
+                      const std::vector<int> &splitters, size_t block, std::vector<std::string> &received,
+                      std::vector<long long> &received_sizes);
+
+    void mergeRunsToFile(const std::vector<std::string> &runs, const std::vector<long long> &run_sizes,
+                         MPI_File output, MPI_Offset offset, size_t budget_keys);
+
+    std::string runPath(int index);
+
     void sendInitialData();
 
     void copyInitialData();
@@ -74,11 +206,13 @@ private:
 
     void quickSort(int from, int to);
 
-    int getPivot(int from, int to);
+    void sortKeys(int *data, int size);
+
+    int getPivot(int from, int to, double fraction);
 
     void broadcastPivot(int &pivot, MPI_Comm current_communicator);
 
-    void updateArr(int rank, MPI_Comm communicator);
+    void updateArr(int rank, int size, MPI_Comm communicator);
 };
 
 #endif
@@ -0,0 +1,279 @@
+#include "quickSortThreads.h"
+#include "localSort.h"
+#include "perfCounters.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+static thread_local int worker_index = 0;
+
+TaskPool::TaskPool(int threads) {
+    // index 0 is the thread that owns the pool, it works only while waiting
+    for (int i = 0; i < threads; i++) {
+        queues.emplace_back(new Queue());
+    }
+    for (int i = 1; i < threads; i++) {
+        workers.emplace_back(&TaskPool::workerLoop, this, i);
+    }
+}
+
+TaskPool::~TaskPool() {
+    stopped = true;
+    for (auto &worker : workers) {
+        worker.join();
+    }
+}
+
+void TaskPool::submit(std::function<void()> task) {
+    Queue &queue = *queues[worker_index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_back(std::move(task));
+}
+
+bool TaskPool::tryRun(int index) {
+    std::function<void()> task;
+    {
+        Queue &own = *queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+        }
+    }
+    for (int i = 1; !task && i < (int) queues.size(); i++) {
+        Queue &victim = *queues[(index + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+    if (!task) {
+        return false;
+    }
+    task();
+    return true;
+}
+
+void TaskPool::wait(const std::atomic<int> &counter) {
+    while (counter.load() > 0) {
+        if (!tryRun(worker_index)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void TaskPool::workerLoop(int index) {
+    static const int SPINS = 1000;
+    worker_index = index;
+    int idle = 0;
+    while (!stopped.load()) {
+        if (tryRun(index)) {
+            idle = 0;
+        } else if (++idle < SPINS) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+}
+
+QuickSortThreads::QuickSortThreads(int argc, char **argv) {
+    this->argc = argc;
+    this->argv = argv;
+    threads = argc > 3 ? std::max(1, atoi(argv[3])) : (int) std::max(1u, std::thread::hardware_concurrency());
+}
+
+double QuickSortThreads::run() {
+    if (argc < 3) {
+        std::cout << "usage: path1 path2 [threads]\n"
+                     "path1 - path to file which data has to be sorted,\n"
+                     "path2 - path to write sorted data,\n"
+                     "threads - number of threads, all cores by default,\n";
+        return -1;
+    }
+    readInitialData();
+    auto start = std::chrono::high_resolution_clock::now();
+    sort(array, threads);
+    auto finish = std::chrono::high_resolution_clock::now();
+    double time = std::chrono::duration<double>(finish - start).count();
+    writeResult();
+    return time;
+}
+
+void QuickSortThreads::readInitialData() {
+    std::ifstream in(argv[1]);
+    int size;
+    in >> size;
+    array.resize(size);
+    for (int &value : array) {
+        in >> value;
+    }
+    std::cerr << size << " " << threads << " ";
+}
+
+void QuickSortThreads::writeResult() {
+    std::ofstream out(argv[2]);
+    out << array.size() << "\n";
+    for (int value : array) {
+        out << value << " ";
+    }
+    out << "\n";
+}
+
+void QuickSortThreads::sort(std::vector<int> &data, int count) {
+    QuickSortThreads sorter(0, nullptr);
+    sorter.threads = count;
+    sorter.array.swap(data);
+    sorter.scratch.resize(sorter.array.size());
+    TaskPool pool(count);
+    sorter.pool = &pool;
+    sorter.spawn(0, sorter.array.size());
+    pool.wait(sorter.pending);
+    sorter.array.swap(data);
+}
+
+void QuickSortThreads::spawn(int from, int to) {
+    pending++;
+    pool->submit([this, from, to]() {
+        sortRange(from, to);
+        pending--;
+    });
+}
+
+void QuickSortThreads::sortRange(int from, int to) {
+    static const int INSERTION = 32;
+    static const int SPAWN = 1 << 13;
+    static const int PARALLEL_PARTITION = 1 << 20;
+    PERF_REGION("sortRange");
+
+    // larger side goes to the pool, the smaller one is continued here
+    while (to - from > INSERTION) {
+        if (to - from < SPAWN) {
+            // not worth a task anymore
+            localSort::introSort(array.data() + from, to - from);
+            return;
+        }
+        int pivot = choosePivot(from, to);
+        auto bounds = (to - from >= PARALLEL_PARTITION && pool->size() > 1) ? parallelPartition(from, to, pivot)
+                                                                            : partition(from, to, pivot);
+        int left_size = bounds.first - from;
+        int right_size = to - bounds.second;
+        if (left_size < right_size) {
+            spawn(bounds.second, to);
+            to = bounds.first;
+        } else {
+            spawn(from, bounds.first);
+            from = bounds.second;
+        }
+    }
+    insertionSort(array.data() + from, to - from);
+}
+
+// median of three medians of three
+int QuickSortThreads::choosePivot(int from, int to) {
+    int *data = array.data();
+    auto median = [data](int a, int b, int c) {
+        return std::max(std::min(data[a], data[b]), std::min(std::max(data[a], data[b]), data[c]));
+    };
+    int step = (to - from) / 8;
+    int mid = from + (to - from) / 2;
+    int a = median(from, from + step, from + 2 * step);
+    int b = median(mid - step, mid, mid + step);
+    int c = median(to - 1 - 2 * step, to - 1 - step, to - 1);
+    return std::max(std::min(a, b), std::min(std::max(a, b), c));
+}
+
+// three-way partition, returns bounds of the keys equal to pivot
+std::pair<int, int> QuickSortThreads::partition(int from, int to, int pivot) {
+    PERF_REGION("partition");
+    int *data = array.data();
+    int i = from;
+    int less = from;
+    int greater = to;
+    while (i < greater) {
+        if (data[i] < pivot) {
+            std::swap(data[less++], data[i++]);
+        } else if (data[i] > pivot) {
+            std::swap(data[i], data[--greater]);
+        } else {
+            i++;
+        }
+    }
+    return {less, greater};
+}
+
+// blocks are partitioned in parallel, then moved to their places through the scratch buffer
+std::pair<int, int> QuickSortThreads::parallelPartition(int from, int to, int pivot) {
+    int blocks = pool->size() * 4;
+    std::vector<int> block_start(blocks + 1);
+    std::vector<std::pair<int, int>> block_bounds(blocks);
+    for (int block = 0; block <= blocks; block++) {
+        block_start[block] = from + (long long) (to - from) * block / blocks;
+    }
+
+    std::atomic<int> remaining(blocks);
+    for (int block = 0; block < blocks; block++) {
+        pool->submit([&, block]() {
+            block_bounds[block] = partition(block_start[block], block_start[block + 1], pivot);
+            remaining--;
+        });
+    }
+    pool->wait(remaining);
+
+    std::vector<int> less_offset(blocks);
+    std::vector<int> equal_offset(blocks);
+    std::vector<int> greater_offset(blocks);
+    int less_total = 0;
+    int equal_total = 0;
+    for (int block = 0; block < blocks; block++) {
+        less_offset[block] = less_total;
+        equal_offset[block] = equal_total;
+        less_total += block_bounds[block].first - block_start[block];
+        equal_total += block_bounds[block].second - block_bounds[block].first;
+    }
+    for (int block = 0, greater_total = 0; block < blocks; block++) {
+        greater_offset[block] = greater_total;
+        greater_total += block_start[block + 1] - block_bounds[block].second;
+    }
+
+    int *data = array.data();
+    int *temp = scratch.data();
+    remaining = blocks;
+    for (int block = 0; block < blocks; block++) {
+        pool->submit([&, block]() {
+            int start = block_start[block];
+            int less_end = block_bounds[block].first;
+            int equal_end = block_bounds[block].second;
+            std::copy(data + start, data + less_end, temp + from + less_offset[block]);
+            std::copy(data + less_end, data + equal_end, temp + from + less_total + equal_offset[block]);
+            std::copy(data + equal_end, data + block_start[block + 1],
+                      temp + from + less_total + equal_total + greater_offset[block]);
+            remaining--;
+        });
+    }
+    pool->wait(remaining);
+
+    remaining = blocks;
+    for (int block = 0; block < blocks; block++) {
+        pool->submit([&, block]() {
+            std::copy(temp + block_start[block], temp + block_start[block + 1], data + block_start[block]);
+            remaining--;
+        });
+    }
+    pool->wait(remaining);
+    return {from + less_total, from + less_total + equal_total};
+}
+
+void QuickSortThreads::insertionSort(int *data, int size) {
+    for (int i = 1; i < size; i++) {
+        int value = data[i];
+        int j = i - 1;
+        while (j >= 0 && data[j] > value) {
+            data[j + 1] = data[j];
+            j--;
+        }
+        data[j + 1] = value;
+    }
+}
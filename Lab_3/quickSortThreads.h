@@ -0,0 +1,80 @@
+#ifndef Lab_3_QUICKSORTTHREADS_H
+#define Lab_3_QUICKSORTTHREADS_H
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// every worker owns a deque: it pushes and pops at the back, idle workers steal from the front of the others
+class TaskPool {
+public:
+    explicit TaskPool(int threads);
+
+    ~TaskPool();
+
+    void submit(std::function<void()> task);
+
+    // runs tasks on the calling thread until counter drops to zero
+    void wait(const std::atomic<int> &counter);
+
+    int size() const {
+        return (int) workers.size() + 1;
+    }
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<bool> stopped{false};
+
+    bool tryRun(int index);
+
+    void workerLoop(int index);
+};
+
+class QuickSortThreads {
+public:
+    QuickSortThreads(int argc, char **argv);
+
+    double run();
+
+    // sorts data with count threads, used by the benchmark as well
+    static void sort(std::vector<int> &data, int count);
+
+private:
+    int argc;
+    char **argv;
+    int threads;
+
+    std::vector<int> array;
+    std::vector<int> scratch;
+    TaskPool *pool = nullptr;
+    std::atomic<int> pending{0};
+
+    void readInitialData();
+
+    void writeResult();
+
+    void sortRange(int from, int to);
+
+    void spawn(int from, int to);
+
+    int choosePivot(int from, int to);
+
+    std::pair<int, int> partition(int from, int to, int pivot);
+
+    std::pair<int, int> parallelPartition(int from, int to, int pivot);
+
+    static void insertionSort(int *data, int size);
+};
+
+#endif
@@ -0,0 +1,147 @@
+#include "quickSortMPI.h"
+#include "perfCounters.h"
+#include <algorithm>
+#include <queue>
+#include <functional>
+
+void QuickSortMPI::startSampleSort() {
+    double start_time = MPI_Wtime();
+    quickSort(0, array_size);
+    phase_time[LOCAL_SORT] += MPI_Wtime() - start_time;
+    start_time = MPI_Wtime();
+
+    int size = MPI_initial_size;
+    order = MPI_initial_rank;
+    if (size == 1) {
+        return;
+    }
+
+    // regular samples of the sorted local part
+    int sample_count = std::min(size, array_size);
+    std::vector<int> samples(sample_count);
+    for (int i = 0; i < sample_count; i++) {
+        samples[i] = array_working_part[(long long) i * array_size / sample_count];
+    }
+
+    std::vector<int> splitters(size - 1);
+    selectSplitters(samples, splitters);
+
+    // local part is sorted, so the keys for every process form one contiguous block
+    std::vector<int> cuts(size - 1);
+    splitEqualKeys(splitters, cuts);
+    std::vector<int> send_counts(size);
+    std::vector<int> send_displacements(size);
+    for (int process = 0, from = 0; process < size; process++) {
+        int to = process == size - 1 ? array_size : cuts[process];
+        send_displacements[process] = from;
+        send_counts[process] = to - from;
+        from = to;
+    }
+
+    std::vector<int> recv_counts(size);
+    std::vector<int> recv_displacements(size);
+    MPI_Alltoall(send_counts.data(), 1, MPI_INT, recv_counts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    int recv_size = 0;
+    for (int process = 0; process < size; process++) {
+        recv_displacements[process] = recv_size;
+        recv_size += recv_counts[process];
+    }
+
+    int *runs = reserveSpare(recv_size);
+    MPI_Alltoallv(array_working_part, send_counts.data(), send_displacements.data(), MPI_INT, runs,
+                  recv_counts.data(), recv_displacements.data(), MPI_INT, MPI_COMM_WORLD);
+    swapBuffers(recv_size);
+    phase_time[PARTITION] += MPI_Wtime() - start_time;
+
+    start_time = MPI_Wtime();
+    mergeRuns(array_working_part, recv_counts, recv_displacements, reserveSpare(recv_size));
+    swapBuffers(recv_size);
+    phase_time[LOCAL_SORT] += MPI_Wtime() - start_time;
+}
+
+// keys equal to a splitter may go to either side of it, a repeated splitter leaves the processes between its
+// copies empty otherwise. As in splitTies, the equal keys fill the global boundary position, ranks in order
+void QuickSortMPI::splitEqualKeys(const std::vector<int> &splitters, std::vector<int> &cuts) {
+    int boundaries = splitters.size();
+    std::vector<long long> local(2 * boundaries + 1);
+    for (int boundary = 0; boundary < boundaries; boundary++) {
+        std::pair<int *, int *> equal = std::equal_range(array_working_part, array_working_part + array_size,
+                                                         splitters[boundary]);
+        local[boundary] = equal.first - array_working_part;
+        local[boundaries + boundary] = equal.second - equal.first;
+    }
+    local[2 * boundaries] = array_size;
+    std::vector<long long> global(2 * boundaries + 1);
+    MPI_Allreduce(local.data(), global.data(), 2 * boundaries + 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+
+    std::vector<long long> equal_before(boundaries);
+    MPI_Exscan(local.data() + boundaries, equal_before.data(), boundaries, MPI_LONG_LONG, MPI_SUM,
+               MPI_COMM_WORLD);
+    if (MPI_initial_rank == MAIN_PROCESS) {
+        std::fill(equal_before.begin(), equal_before.end(), 0LL);
+    }
+
+    long long total = global[2 * boundaries];
+    for (int boundary = 0; boundary < boundaries; boundary++) {
+        long long target = total * (boundary + 1) / MPI_initial_size;
+        long long equal = local[boundaries + boundary];
+        long long equal_low = std::max(0LL, std::min(target - global[boundary], global[boundaries + boundary]));
+        cuts[boundary] = (int) (local[boundary] +
+                                std::max(0LL, std::min(equal_low - equal_before[boundary], equal)));
+    }
+}
+
+void QuickSortMPI::selectSplitters(const std::vector<int> &samples, std::vector<int> &splitters) {
+    int size = MPI_initial_size;
+    int sample_count = samples.size();
+    std::vector<int> counts(size);
+    std::vector<int> displacements(size);
+    MPI_Gather(&sample_count, 1, MPI_INT, counts.data(), 1, MPI_INT, MAIN_PROCESS, MPI_COMM_WORLD);
+
+    std::vector<int> all_samples;
+    if (MPI_initial_rank == MAIN_PROCESS) {
+        int total = 0;
+        for (int process = 0; process < size; process++) {
+            displacements[process] = total;
+            total += counts[process];
+        }
+        all_samples.resize(total);
+    }
+    MPI_Gatherv(samples.data(), sample_count, MPI_INT, all_samples.data(), counts.data(), displacements.data(),
+                MPI_INT, MAIN_PROCESS, MPI_COMM_WORLD);
+
+    if (MPI_initial_rank == MAIN_PROCESS) {
+        std::sort(all_samples.begin(), all_samples.end());
+        int total = all_samples.size();
+        for (int i = 1; i < size; i++) {
+            splitters[i - 1] = total == 0 ? 0 : all_samples[(long long) i * total / size];
+        }
+    }
+    MPI_Bcast(splitters.data(), size - 1, MPI_INT, MAIN_PROCESS, MPI_COMM_WORLD);
+}
+
+void QuickSortMPI::mergeRuns(const int *runs, const std::vector<int> &counts, const std::vector<int> &displacements,
+                             int *merged) {
+    PERF_REGION("mergeRuns");
+    typedef std::pair<int, int> item; // value, run
+    std::priority_queue<item, std::vector<item>, std::greater<item>> heap;
+    std::vector<int> positions(displacements);
+    std::vector<int> ends(counts.size());
+    for (int run = 0; run < (int) counts.size(); run++) {
+        ends[run] = displacements[run] + counts[run];
+        if (counts[run] > 0) {
+            heap.push({runs[positions[run]], run});
+        }
+    }
+
+    int out = 0;
+    while (!heap.empty()) {
+        item top = heap.top();
+        heap.pop();
+        merged[out++] = top.first;
+        int run = top.second;
+        if (++positions[run] < ends[run]) {
+            heap.push({runs[positions[run]], run});
+        }
+    }
+}
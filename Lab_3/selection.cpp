@@ -0,0 +1,149 @@
+#include "quickSortMPI.h"
+#include <algorithm>
+#include <iostream>
+
+void QuickSortMPI::queryRun() {
+    if (MPI_initial_rank == MAIN_PROCESS) {
+        readInitialData();
+    }
+    double start_time = MPI_Wtime();
+    if (MPI_initial_rank == MAIN_PROCESS) {
+        sendInitialData();
+        copyInitialData();
+    } else {
+        waitInitialData();
+    }
+
+    long long size = array_size;
+    long long total;
+    MPI_Allreduce(&size, &total, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+
+    std::vector<int> values;
+    switch (query) {
+        case KTH_QUERY:
+            if (query_k >= 1 && query_k <= total) {
+                values.push_back(selectKth(query_k - 1));
+            }
+            break;
+        case TOP_QUERY:
+            values = selectSmallest(std::max(0LL, std::min(query_k, total)));
+            break;
+        default:
+            for (double fraction : quantiles) {
+                if (total > 0) {
+                    double clamped = std::max(0.0, std::min(1.0, fraction));
+                    values.push_back(selectKth((long long) (clamped * (total - 1))));
+                }
+            }
+            break;
+    }
+    double end_time = MPI_Wtime();
+
+    if (MPI_initial_rank != MAIN_PROCESS) {
+        return;
+    }
+    calc_time = end_time - start_time;
+    std::ofstream out(argv[2]);
+    switch (query) {
+        case KTH_QUERY:
+            if (values.empty()) {
+                std::cout << "k should be from 1 to " << total << "\n";
+            } else {
+                out << values[0] << "\n";
+            }
+            break;
+        case TOP_QUERY:
+            out << values.size() << "\n";
+            for (int value : values) {
+                out << value << " ";
+            }
+            out << "\n";
+            break;
+        default:
+            for (int i = 0; i < (int) values.size(); i++) {
+                out << quantiles[i] << " " << values[i] << "\n";
+            }
+            break;
+    }
+}
+
+// distributed quickselect: the keys never leave their process, only pivots and counts are exchanged.
+// k is zero-based, the result is known on every process
+int QuickSortMPI::selectKth(long long k) {
+    static const long long GATHER_LIMIT = 4096;
+    int from = 0;
+    int to = array_size;
+    while (true) {
+        long long active = to - from;
+        long long total;
+        MPI_Allreduce(&active, &total, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+
+        if (total <= GATHER_LIMIT) {
+            int count = active;
+            std::vector<int> counts(MPI_initial_size);
+            std::vector<int> displacements(MPI_initial_size);
+            MPI_Allgather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+            for (int process = 0, offset = 0; process < MPI_initial_size; process++) {
+                displacements[process] = offset;
+                offset += counts[process];
+            }
+            std::vector<int> rest(total);
+            MPI_Allgatherv(array_working_part + from, count, MPI_INT, rest.data(), counts.data(),
+                           displacements.data(), MPI_INT, MPI_COMM_WORLD);
+            std::nth_element(rest.begin(), rest.begin() + k, rest.end());
+            return rest[k];
+        }
+
+        // pivot is one of the active keys, so every round removes at least one of them
+        int pivot = sampledQuantile(array_working_part + from, active, (k + 0.5) / total, MPI_COMM_WORLD);
+        auto bounds = partitionRange(array_working_part + from, active, pivot);
+        long long local[] = {bounds.first, bounds.second - bounds.first};
+        long long global[2];
+        MPI_Allreduce(local, global, 2, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+
+        if (k < global[0]) {
+            to = from + bounds.first;
+        } else if (k < global[0] + global[1]) {
+            return pivot;
+        } else {
+            k -= global[0] + global[1];
+            from += bounds.second;
+        }
+    }
+}
+
+// k smallest keys in order on the main process
+std::vector<int> QuickSortMPI::selectSmallest(long long k) {
+    std::vector<int> result;
+    if (k == 0) {
+        return result;
+    }
+    int value = selectKth(k - 1);
+    auto bounds = partitionRange(array_working_part, array_size, value);
+
+    // keys equal to the k-th one are taken in rank order until k keys are collected
+    long long local[] = {bounds.first, bounds.second - bounds.first};
+    long long less;
+    MPI_Allreduce(&local[0], &less, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    long long equal_before = 0;
+    MPI_Exscan(&local[1], &equal_before, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    if (MPI_initial_rank == MAIN_PROCESS) {
+        equal_before = 0;
+    }
+    int count = bounds.first + (int) std::max(0LL, std::min(k - less - equal_before, local[1]));
+
+    std::vector<int> counts(MPI_initial_size);
+    std::vector<int> displacements(MPI_initial_size);
+    MPI_Gather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, MAIN_PROCESS, MPI_COMM_WORLD);
+    if (MPI_initial_rank == MAIN_PROCESS) {
+        for (int process = 0, offset = 0; process < MPI_initial_size; process++) {
+            displacements[process] = offset;
+            offset += counts[process];
+        }
+        result.resize(k);
+    }
+    MPI_Gatherv(array_working_part, count, MPI_INT, result.data(), counts.data(), displacements.data(), MPI_INT,
+                MAIN_PROCESS, MPI_COMM_WORLD);
+    std::sort(result.begin(), result.end());
+    return result;
+}
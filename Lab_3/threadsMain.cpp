@@ -0,0 +1,16 @@
+#include <iostream>
+#include "quickSortThreads.h"
+#include "perfCounters.h"
+
+int main(int argc, char **argv) {
+
+    QuickSortThreads qsthreads(argc, argv);
+    double time = qsthreads.run();
+
+    if (time >= 0) {
+        std::cout << "calculation time: " << time << std::endl;
+        std::cerr << time << std::endl;
+    }
+    perf::report(std::cerr);
+    return 0;
+}
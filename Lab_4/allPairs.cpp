@@ -0,0 +1,119 @@
+#include "allPairs.h"
+#include "sssp.h"
+#include "perfCounters.h"
+#include <algorithm>
+
+enum {
+    // 64 x 64 ints is 16 KB, three tiles of a step fit into L1/L2
+    BLOCK = 64,
+    // half of INF so that a sum of two never overflows
+    FW_INF = INF / 2
+};
+
+void multiSourceHeap(const CsrGraph &graph, const std::vector<int> &sources, std::vector<int> &result) {
+    int n = graph.n;
+    result.resize(sources.size() * n);
+#pragma omp parallel
+    {
+        std::vector<int> dist;
+#pragma omp for schedule(dynamic, 1)
+        for (int r = 0; r < (int) sources.size(); r++) {
+            dijkstraHeap(graph, sources[r], dist);
+            std::copy(dist.begin(), dist.end(), result.begin() + (int64_t) r * n);
+        }
+    }
+}
+
+void multiSourceDense(const DenseGraph &matrix, const std::vector<int> &sources,
+                      std::vector<int> &result) {
+    int n = matrix.n;
+    result.resize(sources.size() * n);
+#pragma omp parallel
+    {
+        std::vector<int> dist;
+        std::vector<int> used;
+#pragma omp for schedule(dynamic, 1)
+        for (int r = 0; r < (int) sources.size(); r++) {
+            dijkstraDense(matrix, sources[r], dist, used);
+            std::copy(dist.begin(), dist.end(), result.begin() + (int64_t) r * n);
+        }
+    }
+}
+
+// relaxes tile (ib, jb) through the vertices of block kb, in place also when tiles coincide
+static void updateTile(int *dist, int stride, int ib, int jb, int kb) {
+    for (int k = kb * BLOCK; k < (kb + 1) * BLOCK; k++) {
+        const int *row_k = dist + (int64_t) k * stride;
+        for (int i = ib * BLOCK; i < (ib + 1) * BLOCK; i++) {
+            int *row_i = dist + (int64_t) i * stride;
+            int through_k = row_i[k];
+#pragma omp simd
+            for (int j = jb * BLOCK; j < (jb + 1) * BLOCK; j++) {
+                int candidate = through_k + row_k[j];
+                row_i[j] = candidate < row_i[j] ? candidate : row_i[j];
+            }
+        }
+    }
+}
+
+void floydWarshall(const DenseGraph &matrix, std::vector<int> &result) {
+    int n = matrix.n;
+    int blocks = (n + BLOCK - 1) / BLOCK;
+    int stride = blocks * BLOCK;
+
+    // padded to whole tiles, padding vertices have no edges
+    std::vector<int> dist((int64_t) stride * stride, FW_INF);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            if (matrix[i][j] >= 0) {
+                dist[(int64_t) i * stride + j] = matrix[i][j];
+            }
+        }
+    }
+    for (int i = 0; i < stride; i++) {
+        dist[(int64_t) i * stride + i] = 0;
+    }
+
+    int *data = dist.data();
+#pragma omp parallel
+    {
+        PERF_REGION("floydWarshall");
+        for (int kb = 0; kb < blocks; kb++) {
+            // phase 1: the diagonal tile depends only on itself
+#pragma omp single
+            updateTile(data, stride, kb, kb, kb);
+
+            // phase 2: tiles in row kb and column kb depend on the diagonal one
+#pragma omp for schedule(dynamic, 1)
+            for (int b = 0; b < 2 * blocks; b++) {
+                int other = b % blocks;
+                if (other == kb) {
+                    continue;
+                }
+                if (b < blocks) {
+                    updateTile(data, stride, kb, other, kb);
+                } else {
+                    updateTile(data, stride, other, kb, kb);
+                }
+            }
+
+            // phase 3: the rest depends on row kb and column kb only
+#pragma omp for collapse(2) schedule(dynamic, 1)
+            for (int ib = 0; ib < blocks; ib++) {
+                for (int jb = 0; jb < blocks; jb++) {
+                    if (ib != kb && jb != kb) {
+                        updateTile(data, stride, ib, jb, kb);
+                    }
+                }
+            }
+        }
+    }
+
+    result.resize((int64_t) n * n);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            int value = dist[(int64_t) i * stride + j];
+            result[(int64_t) i * n + j] = value >= FW_INF ? INF : value;
+        }
+    }
+}
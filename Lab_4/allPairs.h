@@ -0,0 +1,17 @@
+#ifndef Lab_4_ALLPAIRS_H
+#define Lab_4_ALLPAIRS_H
+
+#include <vector>
+#include "graph.h"
+
+// one sequential search per source with per-thread state, sources are spread over threads,
+// row r of result (sources.size() x n) holds the distances from sources[r]
+void multiSourceHeap(const CsrGraph &graph, const std::vector<int> &sources, std::vector<int> &result);
+
+void multiSourceDense(const DenseGraph &matrix, const std::vector<int> &sources,
+                      std::vector<int> &result);
+
+// all-pairs distances (n x n) by cache-blocked Floyd-Warshall
+void floydWarshall(const DenseGraph &matrix, std::vector<int> &result);
+
+#endif
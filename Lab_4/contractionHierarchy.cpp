@@ -0,0 +1,287 @@
+#include "contractionHierarchy.h"
+#include <algorithm>
+#include <omp.h>
+
+namespace {
+    enum {
+        // witness searches give up after this many settled vertices and add the shortcut
+        WITNESS_SETTLE_LIMIT = 500,
+        // cheaper searches for priorities only
+        PRIORITY_SETTLE_LIMIT = 50
+    };
+
+    struct Arc {
+        int to;
+        int weight;
+    };
+
+    struct Shortcut {
+        int from;
+        int to;
+        int weight;
+    };
+
+    // graph being contracted, arcs to contracted vertices stay and are skipped
+    struct Overlay {
+        std::vector<std::vector<Arc>> out;
+        std::vector<std::vector<Arc>> in;
+        std::vector<char> contracted;
+        // selected in the current round, witnesses must not go through them either
+        std::vector<char> contracting;
+        std::vector<int> round;
+        std::vector<int> priority;
+        std::vector<int> deleted_neighbours;
+    };
+
+    // keeps the lighter arc when there is one to the same vertex
+    void addArc(std::vector<Arc> &arcs, int to, int weight) {
+        for (Arc &arc : arcs) {
+            if (arc.to == to) {
+                arc.weight = std::min(arc.weight, weight);
+                return;
+            }
+        }
+        arcs.push_back({to, weight});
+    }
+
+    // dijkstra from source among uncontracted vertices except skip, bounded by limit
+    void witnessSearch(const Overlay &overlay, int source, int skip, int limit, int settle_limit,
+                       SearchState &state) {
+        state.reach(source, 0);
+        int settled = 0;
+        while (!state.heap.empty()) {
+            auto top = state.heap.pop();
+            if (top.second > limit || ++settled > settle_limit) {
+                break;
+            }
+            for (const Arc &arc : overlay.out[top.first]) {
+                if (overlay.contracted[arc.to] || overlay.contracting[arc.to] || arc.to == skip) {
+                    continue;
+                }
+                int candidate = top.second + arc.weight;
+                if (candidate <= limit && candidate < state.dist[arc.to]) {
+                    state.reach(arc.to, candidate);
+                }
+            }
+        }
+    }
+
+    // shortcuts u -> w needed when v goes, one witness search per incoming neighbour
+    void contractVertex(const Overlay &overlay, int v, int settle_limit, SearchState &state,
+                        std::vector<Shortcut> &shortcuts) {
+        for (const Arc &in : overlay.in[v]) {
+            int u = in.to;
+            if (overlay.contracted[u]) {
+                continue;
+            }
+            int limit = -1;
+            for (const Arc &out : overlay.out[v]) {
+                if (!overlay.contracted[out.to] && out.to != u) {
+                    limit = std::max(limit, in.weight + out.weight);
+                }
+            }
+            if (limit < 0) {
+                continue;
+            }
+            witnessSearch(overlay, u, v, limit, settle_limit, state);
+            for (const Arc &out : overlay.out[v]) {
+                int w = out.to;
+                if (overlay.contracted[w] || w == u) {
+                    continue;
+                }
+                int through_v = in.weight + out.weight;
+                if (state.dist[w] > through_v) {
+                    shortcuts.push_back({u, w, through_v});
+                }
+            }
+            state.reset();
+        }
+    }
+
+    int priorityOf(const Overlay &overlay, int v, SearchState &state, std::vector<Shortcut> &shortcuts) {
+        shortcuts.clear();
+        contractVertex(overlay, v, PRIORITY_SETTLE_LIMIT, state, shortcuts);
+        int removed = 0;
+        for (const Arc &arc : overlay.out[v]) {
+            removed += !overlay.contracted[arc.to];
+        }
+        for (const Arc &arc : overlay.in[v]) {
+            removed += !overlay.contracted[arc.to];
+        }
+        return (int) shortcuts.size() - removed + overlay.deleted_neighbours[v];
+    }
+
+    bool before(const Overlay &overlay, int a, int b) {
+        return overlay.priority[a] < overlay.priority[b] || (overlay.priority[a] == overlay.priority[b] && a < b);
+    }
+
+    // v goes in this round when no uncontracted neighbour comes before it
+    bool localMinimum(const Overlay &overlay, int v) {
+        for (const std::vector<Arc> *arcs : {&overlay.out[v], &overlay.in[v]}) {
+            for (const Arc &arc : *arcs) {
+                if (!overlay.contracted[arc.to] && arc.to != v && before(overlay, arc.to, v)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    // arcs from a vertex to vertices of later rounds, reversed when going against the edges
+    CsrGraph climbing(const Overlay &overlay, const std::vector<std::vector<Arc>> &arcs) {
+        int n = arcs.size();
+        std::vector<int64_t> offsets(n + 1, 0);
+        std::vector<int> targets;
+        std::vector<int> weights;
+        for (int v = 0; v < n; v++) {
+            for (const Arc &arc : arcs[v]) {
+                if (overlay.round[arc.to] > overlay.round[v]) {
+                    targets.push_back(arc.to);
+                    weights.push_back(arc.weight);
+                }
+            }
+            offsets[v + 1] = targets.size();
+        }
+        return makeCsr(n, std::move(offsets), std::move(targets), std::move(weights));
+    }
+}
+
+ContractionHierarchy::ContractionHierarchy(const CsrGraph &graph) {
+    int n = graph.n;
+    Overlay overlay;
+    overlay.out.resize(n);
+    overlay.in.resize(n);
+    overlay.contracted.assign(n, 0);
+    overlay.contracting.assign(n, 0);
+    overlay.round.assign(n, -1);
+    overlay.priority.assign(n, 0);
+    overlay.deleted_neighbours.assign(n, 0);
+    for (int u = 0; u < n; u++) {
+        for (int64_t e = graph.offsets[u]; e < graph.offsets[u + 1]; e++) {
+            int v = graph.targets[e];
+            if (v != u) {
+                addArc(overlay.out[u], v, graph.weights[e]);
+            }
+        }
+    }
+    for (int u = 0; u < n; u++) {
+        for (const Arc &arc : overlay.out[u]) {
+            overlay.in[arc.to].push_back({u, arc.weight});
+        }
+    }
+
+    std::vector<SearchState> states;
+    std::vector<std::vector<Shortcut>> scratch(omp_get_max_threads());
+    for (int t = 0; t < omp_get_max_threads(); t++) {
+        states.emplace_back(n);
+    }
+
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int v = 0; v < n; v++) {
+        int thread = omp_get_thread_num();
+        overlay.priority[v] = priorityOf(overlay, v, states[thread], scratch[thread]);
+    }
+
+    std::vector<int> remaining(n);
+    for (int v = 0; v < n; v++) {
+        remaining[v] = v;
+    }
+    std::vector<int> stamp(n, -1);
+    std::vector<int> independent;
+    std::vector<int> touched;
+    std::vector<std::vector<Shortcut>> added;
+
+    while (!remaining.empty()) {
+#pragma omp parallel for schedule(dynamic, 256)
+        for (int i = 0; i < (int) remaining.size(); i++) {
+            overlay.contracting[remaining[i]] = localMinimum(overlay, remaining[i]);
+        }
+        independent.clear();
+        int kept = 0;
+        for (int v : remaining) {
+            if (overlay.contracting[v]) {
+                independent.push_back(v);
+            } else {
+                remaining[kept++] = v;
+            }
+        }
+        remaining.resize(kept);
+
+        // no two selected vertices are adjacent, their searches only read the overlay
+        added.assign(independent.size(), std::vector<Shortcut>());
+#pragma omp parallel for schedule(dynamic, 1)
+        for (int i = 0; i < (int) independent.size(); i++) {
+            contractVertex(overlay, independent[i], WITNESS_SETTLE_LIMIT, states[omp_get_thread_num()], added[i]);
+        }
+
+        // neighbours of different selected vertices overlap, so the overlay is updated serially
+        touched.clear();
+        for (int i = 0; i < (int) independent.size(); i++) {
+            int v = independent[i];
+            overlay.contracted[v] = 1;
+            overlay.contracting[v] = 0;
+            overlay.round[v] = round_count;
+            for (const std::vector<Arc> *arcs : {&overlay.out[v], &overlay.in[v]}) {
+                for (const Arc &arc : *arcs) {
+                    if (!overlay.contracted[arc.to] && stamp[arc.to] != round_count) {
+                        stamp[arc.to] = round_count;
+                        touched.push_back(arc.to);
+                    }
+                }
+            }
+            for (const Shortcut &shortcut : added[i]) {
+                addArc(overlay.out[shortcut.from], shortcut.to, shortcut.weight);
+                addArc(overlay.in[shortcut.to], shortcut.from, shortcut.weight);
+            }
+            shortcut_count += added[i].size();
+        }
+        for (int v : touched) {
+            overlay.deleted_neighbours[v]++;
+        }
+
+#pragma omp parallel for schedule(dynamic, 16)
+        for (int i = 0; i < (int) touched.size(); i++) {
+            int thread = omp_get_thread_num();
+            overlay.priority[touched[i]] = priorityOf(overlay, touched[i], states[thread], scratch[thread]);
+        }
+        round_count++;
+    }
+
+    upward = climbing(overlay, overlay.out);
+    downward = climbing(overlay, overlay.in);
+}
+
+int ContractionHierarchy::distance(int start, int target, SearchState &forward, SearchState &backward) const {
+    int best = INF;
+    forward.reach(start, 0);
+    backward.reach(target, 0);
+    bool turn_forward = true;
+    while (true) {
+        // a direction is finished once its heap can't improve the best meeting
+        bool forward_open = !forward.heap.empty() && forward.heap.topKey() < best;
+        bool backward_open = !backward.heap.empty() && backward.heap.topKey() < best;
+        if (!forward_open && !backward_open) {
+            break;
+        }
+        bool go_forward = forward_open && (turn_forward || !backward_open);
+        turn_forward = !turn_forward;
+
+        SearchState &self = go_forward ? forward : backward;
+        const SearchState &other = go_forward ? backward : forward;
+        const CsrGraph &graph = go_forward ? upward : downward;
+        auto top = self.heap.pop();
+        int u = top.first;
+        int du = top.second;
+        if (other.dist[u] != INF) {
+            best = std::min(best, du + other.dist[u]);
+        }
+        for (int64_t e = graph.offsets[u]; e < graph.offsets[u + 1]; e++) {
+            int v = graph.targets[e];
+            int candidate = du + graph.weights[e];
+            if (candidate < self.dist[v]) {
+                self.reach(v, candidate);
+            }
+        }
+    }
+    return best;
+}
@@ -0,0 +1,39 @@
+#ifndef Lab_4_CONTRACTIONHIERARCHY_H
+#define Lab_4_CONTRACTIONHIERARCHY_H
+
+#include <vector>
+#include "graph.h"
+#include "pointToPoint.h"
+
+// vertices are contracted in rounds, each round takes an independent set of vertices whose priority
+// (shortcuts added - edges removed + contracted neighbours) is a local minimum, so their witness searches
+// run in parallel; a query only climbs to vertices of later rounds from both ends
+class ContractionHierarchy {
+public:
+    explicit ContractionHierarchy(const CsrGraph &graph);
+
+    // s-t distance, forward and backward keep the search state between queries
+    int distance(int start, int target, SearchState &forward, SearchState &backward) const;
+
+    int vertices() const {
+        return upward.n;
+    }
+
+    int64_t shortcuts() const {
+        return shortcut_count;
+    }
+
+    int rounds() const {
+        return round_count;
+    }
+
+private:
+    // edges to vertices of later rounds
+    CsrGraph upward;
+    // reversed edges from vertices of later rounds, searched from the target
+    CsrGraph downward;
+    int64_t shortcut_count = 0;
+    int round_count = 0;
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef Lab_4_DHEAP_H
+#define Lab_4_DHEAP_H
+
+#include <utility>
+#include <vector>
+
+// indexed d-ary min-heap of vertices with decrease-key, wider nodes make the heap shallower
+template<int D>
+class DHeap {
+public:
+    explicit DHeap(int n) : position(n, -1) {}
+
+    bool empty() const {
+        return vertices.empty();
+    }
+
+    void pushOrDecrease(int vertex, int key) {
+        int i = position[vertex];
+        if (i < 0) {
+            i = vertices.size();
+            vertices.push_back(vertex);
+            keys.push_back(key);
+            position[vertex] = i;
+        } else if (key >= keys[i]) {
+            return;
+        }
+        keys[i] = key;
+        siftUp(i);
+    }
+
+    int topKey() const {
+        return keys[0];
+    }
+
+    // returns vertex and its key
+    std::pair<int, int> pop() {
+        std::pair<int, int> top = {vertices[0], keys[0]};
+        position[top.first] = -1;
+        int last = vertices.size() - 1;
+        if (last > 0) {
+            vertices[0] = vertices[last];
+            keys[0] = keys[last];
+            position[vertices[0]] = 0;
+        }
+        vertices.pop_back();
+        keys.pop_back();
+        if (!vertices.empty()) {
+            siftDown(0);
+        }
+        return top;
+    }
+
+    void clear() {
+        for (int vertex : vertices) {
+            position[vertex] = -1;
+        }
+        vertices.clear();
+        keys.clear();
+    }
+
+private:
+    std::vector<int> vertices;
+    std::vector<int> keys;
+    std::vector<int> position;
+
+    void siftUp(int i) {
+        int vertex = vertices[i];
+        int key = keys[i];
+        while (i > 0) {
+            int parent = (i - 1) / D;
+            if (keys[parent] <= key) {
+                break;
+            }
+            vertices[i] = vertices[parent];
+            keys[i] = keys[parent];
+            position[vertices[i]] = i;
+            i = parent;
+        }
+        vertices[i] = vertex;
+        keys[i] = key;
+        position[vertex] = i;
+    }
+
+    void siftDown(int i) {
+        int size = vertices.size();
+        int vertex = vertices[i];
+        int key = keys[i];
+        while (true) {
+            int first = D * i + 1;
+            if (first >= size) {
+                break;
+            }
+            int best = first;
+            int last = std::min(first + D, size);
+            for (int child = first + 1; child < last; child++) {
+                if (keys[child] < keys[best]) {
+                    best = child;
+                }
+            }
+            if (keys[best] >= key) {
+                break;
+            }
+            vertices[i] = vertices[best];
+            keys[i] = keys[best];
+            position[vertices[i]] = i;
+            i = best;
+        }
+        vertices[i] = vertex;
+        keys[i] = key;
+        position[vertex] = i;
+    }
+};
+
+#endif
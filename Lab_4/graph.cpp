@@ -0,0 +1,236 @@
+#include "graph.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    struct CsrArrays {
+        std::vector<int64_t> offsets;
+        std::vector<int> targets;
+        std::vector<int> weights;
+    };
+
+    // read-only private mapping of a whole file, unmapped with the last graph that uses it
+    class MappedFile {
+    public:
+        const char *data = nullptr;
+        size_t size = 0;
+
+        explicit MappedFile(const std::string &path) {
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return;
+            }
+            struct stat info;
+            if (fstat(fd, &info) == 0 && info.st_size > 0) {
+                void *address = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (address != MAP_FAILED) {
+                    data = (const char *) address;
+                    size = info.st_size;
+                    // searches jump around the whole graph
+                    madvise(address, size, MADV_WILLNEED);
+                }
+            }
+            close(fd);
+        }
+
+        ~MappedFile() {
+            if (data) {
+                munmap((void *) data, size);
+            }
+        }
+    };
+
+    DenseGraph denseFrom(int n, std::shared_ptr<std::vector<int>> weights) {
+        DenseGraph graph;
+        graph.n = n;
+        graph.weights = weights->data();
+        graph.storage = weights;
+        return graph;
+    }
+
+    CsrGraph csrFrom(int n, std::shared_ptr<CsrArrays> arrays) {
+        CsrGraph graph;
+        graph.n = n;
+        graph.m = arrays->targets.size();
+        graph.offsets = arrays->offsets.data();
+        graph.targets = arrays->targets.data();
+        graph.weights = arrays->weights.data();
+        graph.storage = arrays;
+        return graph;
+    }
+}
+
+DenseGraph readDenseText(const std::string &in_path) {
+    std::ifstream in(in_path);
+    int n;
+    in >> n;
+    auto weights = std::make_shared<std::vector<int>>((int64_t) n * n);
+    for (int &weight : *weights) {
+        in >> weight;
+    }
+    return denseFrom(n, weights);
+}
+
+CsrGraph readEdgeList(const std::string &in_path) {
+    std::ifstream in(in_path);
+    int n;
+    int64_t m;
+    in >> n >> m;
+
+    std::vector<int> from(m);
+    std::vector<int> to(m);
+    std::vector<int> weight(m);
+    auto arrays = std::make_shared<CsrArrays>();
+    arrays->offsets.assign(n + 1, 0);
+    for (int64_t e = 0; e < m; e++) {
+        in >> from[e] >> to[e] >> weight[e];
+        arrays->offsets[from[e] + 1]++;
+    }
+    for (int v = 0; v < n; v++) {
+        arrays->offsets[v + 1] += arrays->offsets[v];
+    }
+
+    // counting sort of the edges by source
+    std::vector<int64_t> position(arrays->offsets.begin(), arrays->offsets.end() - 1);
+    arrays->targets.resize(m);
+    arrays->weights.resize(m);
+    for (int64_t e = 0; e < m; e++) {
+        int64_t slot = position[from[e]]++;
+        arrays->targets[slot] = to[e];
+        arrays->weights[slot] = weight[e];
+    }
+    return csrFrom(n, arrays);
+}
+
+bool mapSnapshot(const std::string &in_path, DenseGraph &dense, CsrGraph &csr) {
+    auto file = std::make_shared<MappedFile>(in_path);
+    if (!file->data || file->size < sizeof(GraphFileHeader)) {
+        std::cerr << "can't map " << in_path << std::endl;
+        return false;
+    }
+    GraphFileHeader header;
+    memcpy(&header, file->data, sizeof(header));
+    const char *body = file->data + sizeof(header);
+    size_t body_size = file->size - sizeof(header);
+
+    if (memcmp(header.magic, DENSE_MAGIC, sizeof(header.magic)) == 0) {
+        if (!snapshotFits(header, true, body_size)) {
+            std::cerr << "bad header or truncated snapshot " << in_path << std::endl;
+            return false;
+        }
+        dense.n = header.n;
+        dense.weights = (const int *) body;
+        dense.storage = file;
+        return true;
+    }
+    if (memcmp(header.magic, CSR_MAGIC, sizeof(header.magic)) == 0) {
+        if (!snapshotFits(header, false, body_size)) {
+            std::cerr << "bad header or truncated snapshot " << in_path << std::endl;
+            return false;
+        }
+        const int64_t *offsets = (const int64_t *) body;
+        if (offsets[0] != 0 || offsets[header.n] != header.m) {
+            std::cerr << "offsets of " << in_path << " don't match its " << header.m << " edges" << std::endl;
+            return false;
+        }
+        csr.n = header.n;
+        csr.m = header.m;
+        csr.offsets = offsets;
+        csr.targets = (const int *) (csr.offsets + header.n + 1);
+        csr.weights = csr.targets + header.m;
+        csr.storage = file;
+        return true;
+    }
+    std::cerr << in_path << " is not a graph snapshot" << std::endl;
+    return false;
+}
+
+void writeSnapshot(const std::string &out_path, const DenseGraph &graph) {
+    std::ofstream out(out_path, std::ios::binary);
+    GraphFileHeader header;
+    memcpy(header.magic, DENSE_MAGIC, sizeof(header.magic));
+    header.n = graph.n;
+    header.m = 0;
+    out.write((const char *) &header, sizeof(header));
+    out.write((const char *) graph.weights, (int64_t) graph.n * graph.n * sizeof(int));
+}
+
+void writeSnapshot(const std::string &out_path, const CsrGraph &graph) {
+    std::ofstream out(out_path, std::ios::binary);
+    GraphFileHeader header;
+    memcpy(header.magic, CSR_MAGIC, sizeof(header.magic));
+    header.n = graph.n;
+    header.m = graph.m;
+    out.write((const char *) &header, sizeof(header));
+    out.write((const char *) graph.offsets, (graph.n + 1) * sizeof(int64_t));
+    out.write((const char *) graph.targets, graph.m * sizeof(int));
+    out.write((const char *) graph.weights, graph.m * sizeof(int));
+}
+
+CsrGraph makeCsr(int n, std::vector<int64_t> offsets, std::vector<int> targets, std::vector<int> weights) {
+    auto arrays = std::make_shared<CsrArrays>();
+    arrays->offsets = std::move(offsets);
+    arrays->targets = std::move(targets);
+    arrays->weights = std::move(weights);
+    return csrFrom(n, arrays);
+}
+
+CsrGraph reverseCsr(const CsrGraph &graph) {
+    int n = graph.n;
+    auto arrays = std::make_shared<CsrArrays>();
+    arrays->offsets.assign(n + 1, 0);
+    for (int64_t e = 0; e < graph.m; e++) {
+        arrays->offsets[graph.targets[e] + 1]++;
+    }
+    for (int v = 0; v < n; v++) {
+        arrays->offsets[v + 1] += arrays->offsets[v];
+    }
+    std::vector<int64_t> position(arrays->offsets.begin(), arrays->offsets.end() - 1);
+    arrays->targets.resize(graph.m);
+    arrays->weights.resize(graph.m);
+    for (int u = 0; u < n; u++) {
+        for (int64_t e = graph.offsets[u]; e < graph.offsets[u + 1]; e++) {
+            int64_t slot = position[graph.targets[e]]++;
+            arrays->targets[slot] = u;
+            arrays->weights[slot] = graph.weights[e];
+        }
+    }
+    return csrFrom(n, arrays);
+}
+
+CsrGraph denseToCsr(const DenseGraph &matrix) {
+    int n = matrix.n;
+    auto arrays = std::make_shared<CsrArrays>();
+    arrays->offsets.reserve(n + 1);
+    arrays->offsets.push_back(0);
+    for (int u = 0; u < n; u++) {
+        for (int v = 0; v < n; v++) {
+            if (matrix[u][v] >= 0) {
+                arrays->targets.push_back(v);
+                arrays->weights.push_back(matrix[u][v]);
+            }
+        }
+        arrays->offsets.push_back(arrays->targets.size());
+    }
+    return csrFrom(n, arrays);
+}
+
+DenseGraph csrToDense(const CsrGraph &graph) {
+    int n = graph.n;
+    auto weights = std::make_shared<std::vector<int>>((int64_t) n * n, -1);
+    for (int u = 0; u < n; u++) {
+        int *row = weights->data() + (int64_t) u * n;
+        for (int64_t e = graph.offsets[u]; e < graph.offsets[u + 1]; e++) {
+            int &weight = row[graph.targets[e]];
+            // parallel edges: the matrix keeps the lightest one
+            weight = weight < 0 ? graph.weights[e] : std::min(weight, graph.weights[e]);
+        }
+    }
+    return denseFrom(n, weights);
+}
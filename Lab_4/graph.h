@@ -0,0 +1,96 @@
+#ifndef Lab_4_GRAPH_H
+#define Lab_4_GRAPH_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#define INF INT32_MAX
+
+// n x n weights in row-major order, negative entries mean no edge;
+// the storage is either vectors built in memory or a mapped snapshot
+struct DenseGraph {
+    int n = 0;
+    const int *weights = nullptr;
+    std::shared_ptr<const void> storage;
+
+    const int *operator[](int u) const {
+        return weights + (int64_t) u * n;
+    }
+};
+
+// compressed sparse rows: outgoing edges of v are [offsets[v], offsets[v + 1])
+struct CsrGraph {
+    int n = 0;
+    int64_t m = 0;
+    const int64_t *offsets = nullptr;
+    const int *targets = nullptr;
+    const int *weights = nullptr;
+    std::shared_ptr<const void> storage;
+
+    int64_t edges() const {
+        return m;
+    }
+};
+
+// graph snapshot: header, then for dense n x n int32 weights,
+// for csr n + 1 int64 offsets, m int32 targets and m int32 weights
+struct GraphFileHeader {
+    char magic[8];
+    int64_t n;
+    int64_t m;
+};
+
+#define DENSE_MAGIC "GRAPHDNS"
+#define CSR_MAGIC "GRAPHCSR"
+
+// counts of the header are not negative, n fits the int vertex ids and the arrays they describe fit into
+// body_size bytes; compared by division, so a forged header can't wrap the byte products around
+inline bool snapshotFits(const GraphFileHeader &header, bool dense, uint64_t body_size) {
+    if (header.n < 0 || header.n > INT32_MAX || header.m < 0) {
+        return false;
+    }
+    uint64_t n = header.n;
+    uint64_t m = header.m;
+    if (dense) {
+        return n == 0 || n <= body_size / sizeof(int) / n;
+    }
+    if (n + 1 > body_size / sizeof(int64_t)) {
+        return false;
+    }
+    return m <= (body_size - (n + 1) * sizeof(int64_t)) / (2 * sizeof(int));
+}
+
+// distance matrix file: header, then rows x cols int32 values, INF for unreachable
+struct DistFileHeader {
+    char magic[8];
+    int64_t rows;
+    int64_t cols;
+};
+
+#define DIST_MAGIC "SSSPDIST"
+
+// n followed by n x n matrix
+DenseGraph readDenseText(const std::string &in_path);
+
+// "n m" followed by m lines "from to weight", edges are directed
+CsrGraph readEdgeList(const std::string &in_path);
+
+// maps a snapshot, exactly one of dense and csr is filled depending on its magic
+bool mapSnapshot(const std::string &in_path, DenseGraph &dense, CsrGraph &csr);
+
+void writeSnapshot(const std::string &out_path, const DenseGraph &graph);
+
+void writeSnapshot(const std::string &out_path, const CsrGraph &graph);
+
+CsrGraph makeCsr(int n, std::vector<int64_t> offsets, std::vector<int> targets, std::vector<int> weights);
+
+// same vertices with every edge turned around, for searches from the target
+CsrGraph reverseCsr(const CsrGraph &graph);
+
+CsrGraph denseToCsr(const DenseGraph &matrix);
+
+DenseGraph csrToDense(const CsrGraph &graph);
+
+#endif
@@ -0,0 +1,186 @@
+#include "incremental.h"
+#include <algorithm>
+#include <omp.h>
+
+IncrementalSssp::IncrementalSssp(const CsrGraph &graph, int start)
+        : n(graph.n), start(start), out(graph.n), in(graph.n), dist(graph.n, INF), parent(graph.n, -1),
+          invalid(graph.n, 0), remembered(graph.n, 0), heap(graph.n) {
+    // parallel edges keep the lightest weight
+    for (int u = 0; u < n; u++) {
+        for (int64_t e = graph.offsets[u]; e < graph.offsets[u + 1]; e++) {
+            int old = setArc(out[u], graph.targets[e], graph.weights[e]);
+            if (old >= 0 && old < graph.weights[e]) {
+                setArc(out[u], graph.targets[e], old);
+            }
+        }
+    }
+    for (int u = 0; u < n; u++) {
+        for (const Arc &arc : out[u]) {
+            in[arc.to].push_back({u, arc.weight});
+        }
+    }
+
+    std::vector<int> seeds = {start};
+    dist[start] = 0;
+    settle(seeds);
+    modified.clear();
+    std::fill(remembered.begin(), remembered.end(), 0);
+}
+
+int IncrementalSssp::setArc(std::vector<Arc> &arcs, int to, int weight) {
+    for (size_t i = 0; i < arcs.size(); i++) {
+        if (arcs[i].to != to) {
+            continue;
+        }
+        int old = arcs[i].weight;
+        if (weight < 0) {
+            arcs[i] = arcs.back();
+            arcs.pop_back();
+        } else {
+            arcs[i].weight = weight;
+        }
+        return old;
+    }
+    if (weight >= 0) {
+        arcs.push_back({to, weight});
+    }
+    return -1;
+}
+
+int IncrementalSssp::arcWeight(const std::vector<Arc> &arcs, int to) {
+    for (const Arc &arc : arcs) {
+        if (arc.to == to) {
+            return arc.weight;
+        }
+    }
+    return -1;
+}
+
+std::vector<int> IncrementalSssp::invalidate(const std::vector<int> &roots) {
+    std::vector<int> all;
+    std::vector<int> level;
+    for (int root : roots) {
+        if (!invalid[root]) {
+            invalid[root] = 1;
+            level.push_back(root);
+        }
+    }
+    std::vector<std::vector<int>> buffers(omp_get_max_threads());
+    while (!level.empty()) {
+        all.insert(all.end(), level.begin(), level.end());
+        // every vertex has one parent, so each child is found by exactly one thread
+#pragma omp parallel
+        {
+            std::vector<int> &buffer = buffers[omp_get_thread_num()];
+#pragma omp for schedule(dynamic, 64)
+            for (int i = 0; i < (int) level.size(); i++) {
+                int u = level[i];
+                for (const Arc &arc : out[u]) {
+                    if (parent[arc.to] == u && !invalid[arc.to]) {
+                        invalid[arc.to] = 1;
+                        buffer.push_back(arc.to);
+                    }
+                }
+            }
+        }
+        level.clear();
+        for (std::vector<int> &buffer : buffers) {
+            level.insert(level.end(), buffer.begin(), buffer.end());
+            buffer.clear();
+        }
+    }
+    return all;
+}
+
+void IncrementalSssp::remember(int v) {
+    if (!remembered[v]) {
+        remembered[v] = 1;
+        modified.push_back({v, dist[v]});
+    }
+}
+
+void IncrementalSssp::settle(const std::vector<int> &seeds) {
+    heap.clear();
+    for (int v : seeds) {
+        if (dist[v] != INF) {
+            heap.pushOrDecrease(v, dist[v]);
+        }
+    }
+    while (!heap.empty()) {
+        auto top = heap.pop();
+        int u = top.first;
+        for (const Arc &arc : out[u]) {
+            int candidate = top.second + arc.weight;
+            if (candidate < dist[arc.to]) {
+                remember(arc.to);
+                dist[arc.to] = candidate;
+                parent[arc.to] = u;
+                heap.pushOrDecrease(arc.to, candidate);
+            }
+        }
+    }
+}
+
+int64_t IncrementalSssp::apply(const std::vector<EdgeChange> &changes) {
+    std::vector<int> roots;
+    std::vector<int> seeds;
+
+    for (const EdgeChange &change : changes) {
+        int old = setArc(out[change.from], change.to, change.weight);
+        setArc(in[change.to], change.from, change.weight);
+        bool longer = change.weight < 0 || (old >= 0 && change.weight > old);
+        // only a tree edge that got longer or vanished can make distances grow
+        if (longer && parent[change.to] == change.from) {
+            roots.push_back(change.to);
+        }
+    }
+
+    // increases: the subtrees lose their distances and take the best offer of a vertex outside them
+    std::vector<int> subtree = invalidate(roots);
+    for (int v : subtree) {
+        remember(v);
+    }
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < (int) subtree.size(); i++) {
+        int v = subtree[i];
+        int best = INF;
+        int best_parent = -1;
+        for (const Arc &arc : in[v]) {
+            int u = arc.to;
+            if (!invalid[u] && dist[u] != INF && dist[u] + arc.weight < best) {
+                best = dist[u] + arc.weight;
+                best_parent = u;
+            }
+        }
+        dist[v] = best;
+        parent[v] = best_parent;
+    }
+    for (int v : subtree) {
+        invalid[v] = 0;
+        seeds.push_back(v);
+    }
+
+    // decreases and insertions seed the vertex they point to, by the weight the arc ended up with since
+    // a later change of the batch may raise or delete it again
+    for (const EdgeChange &change : changes) {
+        int u = change.from;
+        int v = change.to;
+        int weight = arcWeight(out[u], v);
+        if (weight >= 0 && dist[u] != INF && dist[u] + weight < dist[v]) {
+            remember(v);
+            dist[v] = dist[u] + weight;
+            parent[v] = u;
+            seeds.push_back(v);
+        }
+    }
+
+    settle(seeds);
+
+    int64_t changed = 0;
+    for (const std::pair<int, int> &entry : modified) {
+        changed += dist[entry.first] != entry.second;
+        remembered[entry.first] = 0;
+    }
+    modified.clear();
+    return changed;
+}
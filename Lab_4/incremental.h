@@ -0,0 +1,68 @@
+#ifndef Lab_4_INCREMENTAL_H
+#define Lab_4_INCREMENTAL_H
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "graph.h"
+#include "dHeap.h"
+
+// new weight of edge from -> to, inserted when missing, a negative weight deletes it
+struct EdgeChange {
+    int from;
+    int to;
+    int weight;
+};
+
+// single-source distances and shortest path tree kept up to date under batches of edge changes
+class IncrementalSssp {
+public:
+    IncrementalSssp(const CsrGraph &graph, int start);
+
+    // repairs only the vertices the batch affects, returns how many of them changed their distance
+    int64_t apply(const std::vector<EdgeChange> &changes);
+
+    const std::vector<int> &distances() const {
+        return dist;
+    }
+
+    const std::vector<int> &parents() const {
+        return parent;
+    }
+
+private:
+    struct Arc {
+        int to;
+        int weight;
+    };
+
+    int n;
+    int start;
+    std::vector<std::vector<Arc>> out;
+    // arcs reversed, to = source of the edge
+    std::vector<std::vector<Arc>> in;
+    std::vector<int> dist;
+    std::vector<int> parent;
+    std::vector<char> invalid;
+    // distances before the batch of the vertices it touched
+    std::vector<char> remembered;
+    std::vector<std::pair<int, int>> modified;
+    // kept between batches, a small batch only touches the entries it pushes
+    DHeap<4> heap;
+
+    // old weight of the arc or -1 when it did not exist
+    static int setArc(std::vector<Arc> &arcs, int to, int weight);
+
+    // weight of the arc or -1 when it does not exist
+    static int arcWeight(const std::vector<Arc> &arcs, int to);
+
+    // marks the subtrees of roots level by level, returns them
+    std::vector<int> invalidate(const std::vector<int> &roots);
+
+    void remember(int v);
+
+    // heap dijkstra from the seeds at their current distances
+    void settle(const std::vector<int> &seeds);
+};
+
+#endif
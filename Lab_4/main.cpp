@@ -3,63 +3,182 @@
 #include <omp.h>
 #include <string>
 #include <fstream>
+#include <algorithm>
+#include "graph.h"
+#include "sssp.h"
+#include "allPairs.h"
+#include "pointToPoint.h"
+#include "contractionHierarchy.h"
+#include "queryServer.h"
+#include "incremental.h"
+#include "perfCounters.h"
+#include "threadPool.h"
+#include <cstring>
+#include <sstream>
 
 using namespace std;
 
-#define INF INT32_MAX
+enum formats {
+    DENSE_FORMAT, EDGES_FORMAT, BINARY_FORMAT
+};
 
-vector <vector<int>> graph;
+enum engines {
+    DEFAULT_ENGINE, DENSE_ENGINE, HEAP_ENGINE, DELTA_ENGINE
+};
+
+DenseGraph graph;
+CsrGraph csr;
 vector<int> dist;
 vector<int> used;
+vector<int> pred;
+vector<int> path;
 int n;
 
-void dijkstra(int start) {
+enum modes {
+    SINGLE_MODE, BATCH_MODE, ALL_PAIRS_MODE
+};
+
+enum snapshots {
+    NO_SNAPSHOT, DENSE_SNAPSHOT, CSR_SNAPSHOT
+};
+
+int format = DENSE_FORMAT;
+int snapshot = NO_SNAPSHOT;
+bool binaryOutput = false;
+int target = -1;
+bool bidirectional = false;
+bool serve = false;
+string socketPath;
+bool useHierarchy = false;
+string updatesPath;
+int mode = SINGLE_MODE;
+vector<int> sources;
+vector<int> distMatrix;
+int engine = DEFAULT_ENGINE;
+bool poolBackend = false;
+int delta = 0;
+
+// unsettled vertex closest to the start, ties go to the lower index
+struct Candidate {
+    int dist;
+    int vertex;
+};
+
+Candidate closer(const Candidate &a, const Candidate &b) {
+    if (a.dist != b.dist) {
+        return a.dist < b.dist ? a : b;
+    }
+    return a.vertex < b.vertex ? a : b;
+}
+
+#pragma omp declare reduction(argmin : Candidate : omp_out = closer(omp_out, omp_in)) \
+        initializer(omp_priv = Candidate{INF, -1})
 
+// one parallel region for the whole query, threads only meet at the barriers of the worksharing loops;
+// stops early once target is settled, -1 settles everything
+void dijkstra(int start, int target) {
+
+    dist.assign(n, INF);
+    used.assign(n, 0);
+    pred.assign(n, -1);
     dist[start] = 0;
 
-    for (int i = 0; i < n; i++) {
+    Candidate best;
 
-        vector<int> minDistPerThread(omp_get_max_threads(), INF);
-        vector<int> nearestKPerThread(omp_get_max_threads(), -1);
+#pragma omp parallel default(none) shared(n, used, dist, pred, graph, best, target)
+    {
+        PERF_REGION("dijkstra dense");
+        for (int i = 0; i < n; i++) {
 
-#pragma omp parallel for default(none) shared(n, used, dist, minDistPerThread, nearestKPerThread)
-        for (int k = 0; k < n; k++) {
-            int threadNum = omp_get_thread_num();
-            if (!used[k] && (nearestKPerThread[threadNum] < 0 || minDistPerThread[threadNum] > dist[k])) {
-                minDistPerThread[threadNum] = dist[k];
-                nearestKPerThread[threadNum] = k;
+#pragma omp single
+            best = Candidate{INF, -1};
+
+#pragma omp for reduction(argmin: best)
+            for (int k = 0; k < n; k++) {
+                if (!used[k] && dist[k] < best.dist) {
+                    best = Candidate{dist[k], k};
+                }
             }
-        }
 
-        int nearest_k = nearestKPerThread[0];
-        int minDist = minDistPerThread[0];
-        for (int j = 0; j < minDistPerThread.size(); j++) {
-            if (minDist > minDistPerThread[j]) {
-                minDist = minDistPerThread[j];
-                nearest_k = nearestKPerThread[j];
+            // every thread sees the same winner, the rest is unreachable once it is INF
+            int nearest_k = best.vertex;
+            if (nearest_k < 0 || nearest_k == target) {
+                break;
             }
-        }
-        used[nearest_k] = 1;
+            int base = best.dist;
+            const int *row = graph[nearest_k];
+            int *dist_data = dist.data();
+            int *pred_data = pred.data();
+
+#pragma omp single nowait
+            used[nearest_k] = 1;
 
-#pragma omp parallel for default(none) shared(n, used, dist, graph, nearest_k)
-        for (int v = 0; v < n; v++) {
-            if (graph[nearest_k][v] >= 0) {
-                dist[v] = min(dist[v], dist[nearest_k] + graph[nearest_k][v]);
+#pragma omp for simd
+            for (int v = 0; v < n; v++) {
+                int candidate = row[v] >= 0 ? base + row[v] : INF;
+                int old = dist_data[v];
+                // select by mask, with two conditional stores the loop is not vectorised
+                int mask = -(candidate < old);
+                dist_data[v] = (candidate & mask) | (old & ~mask);
+                pred_data[v] = (nearest_k & mask) | (pred_data[v] & ~mask);
             }
         }
     }
 }
 
-void readGraph(const string &in_path) {
-    ifstream in(in_path);
-    in >> n;
-    graph.resize(n, vector<int>(n));
-    dist.resize(n, INF);
-    used.resize(n, 0);
+// the same search on the persistent pool: every thread relaxes its block of the last settled row and picks
+// the closest unsettled vertex of the block in the same pass, so a vertex costs one dispatch instead of
+// the four barriers of the worksharing loops
+void dijkstraPool(pool::ThreadPool &workers, int start, int target) {
+
+    dist.assign(n, INF);
+    used.assign(n, 0);
+    pred.assign(n, -1);
+    dist[start] = 0;
+
+    int *dist_data = dist.data();
+    int *pred_data = pred.data();
+    const int *used_data = used.data();
+    int nearest_k = -1;
+    int base = 0;
+
     for (int i = 0; i < n; i++) {
-        for (int j = 0; j < n; j++) {
-            in >> graph[i][j];
+        const int *row = nearest_k < 0 ? nullptr : graph[nearest_k];
+        Candidate best = workers.parallelReduce(
+                0, n, Candidate{INF, -1},
+                [&](int64_t begin, int64_t end, Candidate &partial) {
+                    if (row) {
+                        for (int v = begin; v < end; v++) {
+                            int candidate = row[v] >= 0 ? base + row[v] : INF;
+                            int old = dist_data[v];
+                            int mask = -(candidate < old);
+                            dist_data[v] = (candidate & mask) | (old & ~mask);
+                            pred_data[v] = (nearest_k & mask) | (pred_data[v] & ~mask);
+                        }
+                    }
+                    for (int v = begin; v < end; v++) {
+                        if (!used_data[v] && dist_data[v] < partial.dist) {
+                            partial = Candidate{dist_data[v], v};
+                        }
+                    }
+                }, closer);
+
+        nearest_k = best.vertex;
+        if (nearest_k < 0 || nearest_k == target) {
+            break;
         }
+        base = best.dist;
+        used[nearest_k] = 1;
+    }
+}
+
+// pool threads follow OMP_NUM_THREADS like the OpenMP backend
+void denseDijkstra(int start, int target) {
+    if (poolBackend) {
+        pool::ThreadPool workers(omp_get_max_threads());
+        dijkstraPool(workers, start, target);
+    } else {
+        dijkstra(start, target);
     }
 }
 
@@ -74,28 +193,285 @@ void writeDist(const string &out_path) {
     }
 }
 
+// distance on the first line and vertices of the path on the second, INF when unreachable
+void writePath(const string &out_path) {
+    ofstream out(out_path);
+    if (path.empty()) {
+        out << "INF\n";
+        return;
+    }
+    out << dist[target] << "\n";
+    for (int v : path) {
+        out << v << " ";
+    }
+    out << "\n";
+}
+
+// rows x n distances with a header, a single source is one row
+void writeDistMatrix(const string &out_path, int64_t rows, const vector<int> &values) {
+    ofstream out(out_path, ios::binary);
+    DistFileHeader header;
+    memcpy(header.magic, DIST_MAGIC, sizeof(header.magic));
+    header.rows = rows;
+    header.cols = n;
+    out.write((const char *) &header, sizeof(header));
+    out.write((const char *) values.data(), rows * n * sizeof(int));
+}
+
+// start is a vertex, a comma separated list, @file with a list or "all"
+void readSources(const string &start) {
+    if (start == "all") {
+        mode = ALL_PAIRS_MODE;
+        return;
+    }
+    string list = start;
+    if (start[0] == '@') {
+        ifstream in(start.substr(1));
+        list.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+        mode = BATCH_MODE;
+    } else if (start.find(',') != string::npos) {
+        mode = BATCH_MODE;
+    }
+    replace(list.begin(), list.end(), ',', ' ');
+    istringstream in(list);
+    int vertex;
+    while (in >> vertex) {
+        sources.push_back(vertex);
+    }
+}
+
+// batches of edge changes separated by empty lines
+vector<vector<EdgeChange>> readUpdates(const string &updates_path) {
+    ifstream in(updates_path);
+    vector<vector<EdgeChange>> batches(1);
+    string line;
+    while (getline(in, line)) {
+        istringstream fields(line);
+        EdgeChange change;
+        if (fields >> change.from >> change.to >> change.weight) {
+            if (change.from < 0 || change.from >= csr.n || change.to < 0 || change.to >= csr.n) {
+                cerr << updates_path << " has edges with vertices out of range" << endl;
+                exit(1);
+            }
+            batches.back().push_back(change);
+        } else if (!batches.back().empty()) {
+            batches.emplace_back();
+        }
+    }
+    if (batches.back().empty()) {
+        batches.pop_back();
+    }
+    return batches;
+}
+
+// keeps dist up to date through every batch, each one is timed separately
+void runUpdates(int start) {
+    vector<vector<EdgeChange>> batches = readUpdates(updatesPath);
+    IncrementalSssp incremental(csr, start);
+    for (size_t i = 0; i < batches.size(); i++) {
+        double batchStart = omp_get_wtime();
+        int64_t changed = incremental.apply(batches[i]);
+        double batchEnd = omp_get_wtime();
+        cerr << "batch " << i << ": " << batches[i].size() << " changes, " << changed << " distances changed, "
+             << batchEnd - batchStart << endl;
+    }
+    dist = incremental.distances();
+}
+
+void readOptions(int argc, char **argv) {
+    for (int i = 4; i < argc; i++) {
+        string option(argv[i]);
+        if (option == "--format=dense") {
+            format = DENSE_FORMAT;
+        } else if (option == "--format=edges") {
+            format = EDGES_FORMAT;
+        } else if (option == "--format=binary") {
+            format = BINARY_FORMAT;
+        } else if (option == "--to-binary=dense") {
+            snapshot = DENSE_SNAPSHOT;
+        } else if (option == "--to-binary=csr") {
+            snapshot = CSR_SNAPSHOT;
+        } else if (option.rfind("--target=", 0) == 0) {
+            target = stoi(option.substr(9));
+        } else if (option == "--bidirectional") {
+            bidirectional = true;
+        } else if (option == "--serve") {
+            serve = true;
+        } else if (option.rfind("--socket=", 0) == 0) {
+            serve = true;
+            socketPath = option.substr(9);
+        } else if (option.rfind("--updates=", 0) == 0) {
+            updatesPath = option.substr(10);
+        } else if (option == "--ch") {
+            useHierarchy = true;
+        } else if (option == "--binary-output") {
+            binaryOutput = true;
+        } else if (option == "--engine=dense") {
+            engine = DENSE_ENGINE;
+        } else if (option == "--engine=heap") {
+            engine = HEAP_ENGINE;
+        } else if (option == "--engine=delta") {
+            engine = DELTA_ENGINE;
+        } else if (option == "--backend=openmp") {
+            poolBackend = false;
+        } else if (option == "--backend=pool") {
+            poolBackend = true;
+        } else if (option.rfind("--delta=", 0) == 0) {
+            delta = stoi(option.substr(8));
+        } else {
+            cerr << "unknown option: " << option << endl;
+            exit(1);
+        }
+    }
+    if (snapshot != NO_SNAPSHOT) {
+        engine = snapshot == DENSE_SNAPSHOT ? DENSE_ENGINE : HEAP_ENGINE;
+    }
+}
+
+// loads path1 in its format and builds the representation the engine needs,
+// by default the engine follows what was loaded
+void loadGraph(const string &in_path) {
+    if (format == BINARY_FORMAT) {
+        if (!mapSnapshot(in_path, graph, csr)) {
+            exit(1);
+        }
+    } else if (format == DENSE_FORMAT) {
+        graph = readDenseText(in_path);
+    } else {
+        csr = readEdgeList(in_path);
+    }
+    bool denseLoaded = !csr.storage;
+    n = denseLoaded ? graph.n : csr.n;
+    if (engine == DEFAULT_ENGINE) {
+        engine = denseLoaded ? DENSE_ENGINE : HEAP_ENGINE;
+    }
+    if (engine == DENSE_ENGINE && !denseLoaded) {
+        graph = csrToDense(csr);
+    } else if (engine != DENSE_ENGINE && denseLoaded) {
+        csr = denseToCsr(graph);
+        graph = DenseGraph();
+    }
+}
+
 int main(int argc, char **argv) {
 
     if (argc < 4) {
-        cout << "usage: path1 start path2\n"
+        cout << "usage: path1 start path2 [options]\n"
                 "path1 - path to graph\n"
-                "start - first vertex for dijkstra\n"
-                "path2 - path to output distance matrix\n";
+                "start - first vertex for dijkstra; v1,v2,... or @file with vertices for a batch of sources;\n"
+                "        all for all pairs by blocked Floyd-Warshall\n"
+                "path2 - path to output distances, a batch or all pairs is written as binary matrix\n"
+                "options:\n"
+                "--format=dense - path1 is n and n x n matrix, -1 means no edge (default)\n"
+                "--format=edges - path1 is \"n m\" and m lines \"from to weight\"\n"
+                "--format=binary - path1 is a snapshot written by --to-binary, it is mapped without parsing\n"
+                "--to-binary=dense - convert path1 to a dense snapshot in path2, start is ignored\n"
+                "--to-binary=csr - convert path1 to a sparse rows snapshot in path2, start is ignored\n"
+                "--target=t - stop once t is settled, path2 gets the distance and the path from start to t\n"
+                "--bidirectional - with --target, search from both ends at once on sparse rows\n"
+                "--serve - keep the graph loaded and answer \"s t\", \"s *\" and \"stats\" lines from stdin,\n"
+                "          start and path2 are ignored\n"
+                "--socket=path - serve clients of a unix socket instead of stdin\n"
+                "--ch - build a contraction hierarchy for s-t queries of the server\n"
+                "--updates=path - after the search apply batches of \"from to weight\" lines (-1 deletes the edge,\n"
+                "                 an empty line ends a batch) incrementally, path2 gets the final distances\n"
+                "--binary-output - write distances from a single source as binary matrix with one row\n"
+                "--engine=dense - O(n^2) parallel dijkstra on the matrix (default for dense format)\n"
+                "--engine=heap - dijkstra with 4-ary heap on sparse rows (default for edges format)\n"
+                "--engine=delta - parallel delta-stepping on sparse rows\n"
+                "--delta=D - bucket width for delta-stepping, 0 picks it from weights and degree (default)\n"
+                "--backend=openmp - dense dijkstra in an OpenMP parallel region (default)\n"
+                "--backend=pool - dense dijkstra on persistent pinned threads, one dispatch per settled vertex\n";
         return 0;
     }
 
     string in(argv[1]);
     string out(argv[3]);
-    int start = atoi(argv[2]);
+    readSources(argv[2]);
+    readOptions(argc, argv);
+    if (target >= 0 && mode != SINGLE_MODE) {
+        cerr << "--target needs a single start" << endl;
+        return 1;
+    }
+    // Floyd-Warshall works on the matrix, bidirectional search on sparse rows
+    if (mode == ALL_PAIRS_MODE) {
+        engine = DENSE_ENGINE;
+    } else if (bidirectional || serve || !updatesPath.empty()) {
+        engine = HEAP_ENGINE;
+    }
+    int start = sources.empty() ? 0 : sources[0];
+
+    loadGraph(in);
 
-    readGraph(in);
+    if (snapshot == DENSE_SNAPSHOT) {
+        writeSnapshot(out, graph);
+        return 0;
+    } else if (snapshot == CSR_SNAPSHOT) {
+        writeSnapshot(out, csr);
+        return 0;
+    }
+
+    if (serve) {
+        unique_ptr<ContractionHierarchy> hierarchy;
+        if (useHierarchy) {
+            double buildStart = omp_get_wtime();
+            hierarchy.reset(new ContractionHierarchy(csr));
+            cerr << "ch " << hierarchy->rounds() << " rounds " << hierarchy->shortcuts() << " shortcuts "
+                 << omp_get_wtime() - buildStart << endl;
+        }
+        QueryServer server(csr, hierarchy.get(), omp_get_max_threads());
+        if (socketPath.empty()) {
+            server.serveStream(stdin, stdout);
+        } else {
+            server.serveSocket(socketPath);
+        }
+        return 0;
+    }
 
     double startTime = omp_get_wtime();
-    dijkstra(start);
+    if (mode == ALL_PAIRS_MODE) {
+        floydWarshall(graph, distMatrix);
+    } else if (mode == BATCH_MODE) {
+        if (engine == DENSE_ENGINE) {
+            multiSourceDense(graph, sources, distMatrix);
+        } else {
+            multiSourceHeap(csr, sources, distMatrix);
+        }
+    } else if (target >= 0) {
+        if (bidirectional) {
+            dist.assign(n, INF);
+            dist[target] = bidirectionalDijkstra(csr, reverseCsr(csr), start, target, path);
+        } else if (engine == DENSE_ENGINE) {
+            denseDijkstra(start, target);
+            path = tracePath(pred, start, target);
+        } else {
+            dijkstraTarget(csr, start, target, dist, pred);
+            path = tracePath(pred, start, target);
+        }
+    } else if (engine == DENSE_ENGINE) {
+        denseDijkstra(start, -1);
+    } else if (engine == HEAP_ENGINE) {
+        dijkstraHeap(csr, start, dist);
+    } else {
+        deltaStepping(csr, start, dist, delta);
+    }
     double endTime = omp_get_wtime();
 
-    writeDist(out);
+    if (!updatesPath.empty() && mode == SINGLE_MODE && target < 0) {
+        runUpdates(start);
+    }
+
+    if (target >= 0) {
+        writePath(out);
+    } else if (mode != SINGLE_MODE) {
+        writeDistMatrix(out, mode == ALL_PAIRS_MODE ? n : sources.size(), distMatrix);
+    } else if (binaryOutput) {
+        writeDistMatrix(out, 1, dist);
+    } else {
+        writeDist(out);
+    }
 
     cerr << n << " " << endTime - startTime << endl;
+    perf::report(cerr);
     return 0;
 }
@@ -0,0 +1,13 @@
+#include <iostream>
+#include "ssspMPI.h"
+
+int main(int argc, char **argv) {
+
+    SsspMPI sssp(argc, argv);
+    double time = sssp.run();
+
+    if (time >= 0) {
+        std::cerr << sssp.vertices() << " " << sssp.processes() << " " << time << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include "pointToPoint.h"
+#include <algorithm>
+#include <mutex>
+
+int dijkstraTarget(const CsrGraph &graph, int start, int target, std::vector<int> &dist, std::vector<int> &pred) {
+    dist.assign(graph.n, INF);
+    pred.assign(graph.n, -1);
+    DHeap<4> heap(graph.n);
+    dist[start] = 0;
+    heap.pushOrDecrease(start, 0);
+    while (!heap.empty()) {
+        auto top = heap.pop();
+        int u = top.first;
+        int du = top.second;
+        if (u == target) {
+            break;
+        }
+        for (int64_t e = graph.offsets[u]; e < graph.offsets[u + 1]; e++) {
+            int v = graph.targets[e];
+            int candidate = du + graph.weights[e];
+            if (candidate < dist[v]) {
+                dist[v] = candidate;
+                pred[v] = u;
+                heap.pushOrDecrease(v, candidate);
+            }
+        }
+    }
+    return dist[target];
+}
+
+int dijkstraTarget(const CsrGraph &graph, int start, int target, SearchState &state) {
+    state.reach(start, 0);
+    while (!state.heap.empty()) {
+        auto top = state.heap.pop();
+        int u = top.first;
+        int du = top.second;
+        if (u == target) {
+            return du;
+        }
+        for (int64_t e = graph.offsets[u]; e < graph.offsets[u + 1]; e++) {
+            int v = graph.targets[e];
+            int candidate = du + graph.weights[e];
+            if (candidate < state.dist[v]) {
+                state.reach(v, candidate);
+            }
+        }
+    }
+    return target < 0 ? 0 : state.dist[target];
+}
+
+std::vector<int> tracePath(const std::vector<int> &pred, int start, int target) {
+    std::vector<int> path;
+    if (target != start && pred[target] < 0) {
+        return path;
+    }
+    for (int v = target; v != start; v = pred[v]) {
+        path.push_back(v);
+    }
+    path.push_back(start);
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+namespace {
+    // state of one direction, dist and radius are read by the other thread
+    struct Search {
+        const CsrGraph *graph;
+        std::vector<int> dist;
+        std::vector<int> pred;
+        // lower bound of every key still in the heap, INF when the heap is empty
+        int radius = 0;
+    };
+
+    // best path found so far goes through edge from -> to, from is reached forward and to backward
+    struct Meeting {
+        std::mutex lock;
+        int length = INF;
+        int from = -1;
+        int to = -1;
+    };
+
+    void offer(Meeting &meeting, int64_t length, int from, int to) {
+        if (length >= __atomic_load_n(&meeting.length, __ATOMIC_SEQ_CST)) {
+            return;
+        }
+        std::lock_guard<std::mutex> guard(meeting.lock);
+        if (length < meeting.length) {
+            meeting.from = from;
+            meeting.to = to;
+            __atomic_store_n(&meeting.length, (int) length, __ATOMIC_SEQ_CST);
+        }
+    }
+
+    void search(Search &self, Search &other, Meeting &meeting, int start, bool forward) {
+        const CsrGraph &graph = *self.graph;
+        DHeap<4> heap(graph.n);
+        heap.pushOrDecrease(start, 0);
+        while (!heap.empty()) {
+            int key = heap.topKey();
+            __atomic_store_n(&self.radius, key, __ATOMIC_SEQ_CST);
+            int64_t other_radius = __atomic_load_n(&other.radius, __ATOMIC_SEQ_CST);
+            // any path still unseen is at least as long as both radii together
+            if (key + other_radius >= __atomic_load_n(&meeting.length, __ATOMIC_SEQ_CST)) {
+                return;
+            }
+            int u = heap.pop().first;
+            for (int64_t e = graph.offsets[u]; e < graph.offsets[u + 1]; e++) {
+                int v = graph.targets[e];
+                int candidate = key + graph.weights[e];
+                if (candidate < self.dist[v]) {
+                    __atomic_store_n(&self.dist[v], candidate, __ATOMIC_SEQ_CST);
+                    self.pred[v] = u;
+                    heap.pushOrDecrease(v, candidate);
+                }
+                // the store above and this load pair with the other thread, one of them sees the meeting
+                int64_t rest = __atomic_load_n(&other.dist[v], __ATOMIC_SEQ_CST);
+                if (rest != INF) {
+                    if (forward) {
+                        offer(meeting, (int64_t) key + graph.weights[e] + rest, u, v);
+                    } else {
+                        offer(meeting, (int64_t) key + graph.weights[e] + rest, v, u);
+                    }
+                }
+            }
+        }
+        __atomic_store_n(&self.radius, INF, __ATOMIC_SEQ_CST);
+    }
+}
+
+int bidirectionalDijkstra(const CsrGraph &graph, const CsrGraph &reverse, int start, int target,
+                          std::vector<int> &path) {
+    path.clear();
+    if (start == target) {
+        path.push_back(start);
+        return 0;
+    }
+
+    Search forward;
+    Search backward;
+    forward.graph = &graph;
+    backward.graph = &reverse;
+    for (Search *side : {&forward, &backward}) {
+        side->dist.assign(graph.n, INF);
+        side->pred.assign(graph.n, -1);
+    }
+    forward.dist[start] = 0;
+    backward.dist[target] = 0;
+    Meeting meeting;
+
+#pragma omp parallel sections num_threads(2)
+    {
+#pragma omp section
+        search(forward, backward, meeting, start, true);
+#pragma omp section
+        search(backward, forward, meeting, target, false);
+    }
+
+    if (meeting.length == INF) {
+        return INF;
+    }
+    path = tracePath(forward.pred, start, meeting.from);
+    for (int v = meeting.to; v != -1; v = backward.pred[v]) {
+        path.push_back(v);
+    }
+    return meeting.length;
+}
@@ -0,0 +1,48 @@
+#ifndef Lab_4_POINTTOPOINT_H
+#define Lab_4_POINTTOPOINT_H
+
+#include <vector>
+#include "graph.h"
+#include "dHeap.h"
+
+// dist and heap of one search kept between queries, only the entries a query touched are reset
+struct SearchState {
+    std::vector<int> dist;
+    std::vector<int> touched;
+    DHeap<4> heap;
+
+    explicit SearchState(int n) : dist(n, INF), heap(n) {}
+
+    void reach(int v, int d) {
+        if (dist[v] == INF) {
+            touched.push_back(v);
+        }
+        dist[v] = d;
+        heap.pushOrDecrease(v, d);
+    }
+
+    void reset() {
+        for (int v : touched) {
+            dist[v] = INF;
+        }
+        touched.clear();
+        heap.clear();
+    }
+};
+
+// heap dijkstra that stops as soon as target is settled, returns its distance;
+// pred[v] is the vertex v was reached from, -1 for start and unreached vertices
+int dijkstraTarget(const CsrGraph &graph, int start, int target, std::vector<int> &dist, std::vector<int> &pred);
+
+// same search on reusable state, the caller resets it; target -1 settles everything reachable
+int dijkstraTarget(const CsrGraph &graph, int start, int target, SearchState &state);
+
+// forward search from start on graph and backward search from target on reverse run on two threads
+// and stop once their radii sum up to the best meeting found, path gets the vertices from start to target
+int bidirectionalDijkstra(const CsrGraph &graph, const CsrGraph &reverse, int start, int target,
+                          std::vector<int> &path);
+
+// vertices from start to target along pred, empty when target is unreached
+std::vector<int> tracePath(const std::vector<int> &pred, int start, int target);
+
+#endif
@@ -0,0 +1,237 @@
+#include "queryServer.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+struct QueryServer::Session {
+    std::mutex lock;
+    std::condition_variable ready;
+    // finished answers waiting for the ones before them
+    std::map<int64_t, std::string> answers;
+    int64_t submitted = 0;
+    int64_t written = 0;
+    bool reading_done = false;
+    // microseconds from reading a query to its answer
+    std::vector<double> latencies;
+};
+
+QueryServer::QueryServer(const CsrGraph &graph, const ContractionHierarchy *hierarchy, int threads)
+        : graph(graph), hierarchy(hierarchy) {
+    for (int i = 0; i < threads; i++) {
+        workers.emplace_back(&QueryServer::work, this);
+    }
+}
+
+QueryServer::~QueryServer() {
+    {
+        std::lock_guard<std::mutex> guard(tasks_lock);
+        stopping = true;
+    }
+    tasks_ready.notify_all();
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+void QueryServer::work() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> guard(tasks_lock);
+            tasks_ready.wait(guard, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
+
+void QueryServer::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> guard(tasks_lock);
+        tasks.push(std::move(task));
+    }
+    tasks_ready.notify_one();
+}
+
+std::unique_ptr<QueryServer::Scratch> QueryServer::takeScratch() {
+    {
+        std::lock_guard<std::mutex> guard(scratch_lock);
+        if (!free_scratch.empty()) {
+            std::unique_ptr<Scratch> scratch = std::move(free_scratch.back());
+            free_scratch.pop_back();
+            return scratch;
+        }
+    }
+    return std::unique_ptr<Scratch>(new Scratch(graph.n));
+}
+
+void QueryServer::returnScratch(std::unique_ptr<Scratch> scratch) {
+    scratch->forward.reset();
+    scratch->backward.reset();
+    std::lock_guard<std::mutex> guard(scratch_lock);
+    free_scratch.push_back(std::move(scratch));
+}
+
+std::string QueryServer::latencySummary(std::vector<double> latencies) {
+    std::ostringstream summary;
+    summary << "queries " << latencies.size();
+    if (latencies.empty()) {
+        return summary.str();
+    }
+    std::sort(latencies.begin(), latencies.end());
+    auto percentile = [&](double p) {
+        return latencies[std::min(latencies.size() - 1, (size_t) (p * latencies.size()))];
+    };
+    summary << " p50 " << percentile(0.5) << " p90 " << percentile(0.9) << " p99 " << percentile(0.99)
+            << " max " << latencies.back() << " us";
+    return summary.str();
+}
+
+std::string QueryServer::answer(const std::string &query, Session &session) {
+    if (query == "stats") {
+        std::lock_guard<std::mutex> guard(session.lock);
+        return latencySummary(session.latencies);
+    }
+    std::istringstream in(query);
+    int start;
+    std::string target;
+    if (!(in >> start >> target) || start < 0 || start >= graph.n) {
+        return "error: " + query;
+    }
+
+    std::ostringstream out;
+    std::unique_ptr<Scratch> scratch = takeScratch();
+    if (target == "*") {
+        dijkstraTarget(graph, start, -1, scratch->forward);
+        out << start << " *";
+        for (int v = 0; v < graph.n; v++) {
+            int d = scratch->forward.dist[v];
+            if (d == INF) {
+                out << " INF";
+            } else {
+                out << " " << d;
+            }
+        }
+    } else {
+        int t = atoi(target.c_str());
+        if (t < 0 || t >= graph.n) {
+            returnScratch(std::move(scratch));
+            return "error: " + query;
+        }
+        int d = hierarchy ? hierarchy->distance(start, t, scratch->forward, scratch->backward)
+                          : dijkstraTarget(graph, start, t, scratch->forward);
+        out << start << " " << t << " ";
+        if (d == INF) {
+            out << "INF";
+        } else {
+            out << d;
+        }
+    }
+    returnScratch(std::move(scratch));
+    return out.str();
+}
+
+void QueryServer::serveStream(FILE *in, FILE *out) {
+    Session session;
+    auto begin = std::chrono::steady_clock::now();
+
+    // answers leave in query order, as soon as the next one is ready
+    std::thread writer([&session, out] {
+        std::unique_lock<std::mutex> guard(session.lock);
+        while (true) {
+            session.ready.wait(guard, [&session] {
+                return session.answers.count(session.written) ||
+                       (session.reading_done && session.written == session.submitted);
+            });
+            if (!session.answers.count(session.written)) {
+                return;
+            }
+            std::string line = std::move(session.answers[session.written]);
+            session.answers.erase(session.written++);
+            guard.unlock();
+            fputs(line.c_str(), out);
+            fputc('\n', out);
+            fflush(out);
+            guard.lock();
+        }
+    });
+
+    char *buffer = nullptr;
+    size_t capacity = 0;
+    ssize_t length;
+    while ((length = getline(&buffer, &capacity, in)) > 0) {
+        std::string query(buffer, length);
+        query.erase(query.find_last_not_of(" \r\n") + 1);
+        if (query.empty()) {
+            continue;
+        }
+        auto received = std::chrono::steady_clock::now();
+        int64_t id;
+        {
+            std::lock_guard<std::mutex> guard(session.lock);
+            id = session.submitted++;
+        }
+        submit([this, &session, query, id, received] {
+            std::string line = answer(query, session);
+            double latency = std::chrono::duration<double, std::micro>(
+                    std::chrono::steady_clock::now() - received).count();
+            {
+                std::lock_guard<std::mutex> guard(session.lock);
+                session.answers[id] = std::move(line);
+                session.latencies.push_back(latency);
+                // under the lock, the session may be gone right after the last answer
+                session.ready.notify_all();
+            }
+        });
+    }
+    free(buffer);
+    {
+        std::lock_guard<std::mutex> guard(session.lock);
+        session.reading_done = true;
+    }
+    session.ready.notify_all();
+    writer.join();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::cerr << latencySummary(session.latencies) << ", " << session.latencies.size() / seconds
+              << " queries/s" << std::endl;
+}
+
+void QueryServer::serveSocket(const std::string &socket_path) {
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (listener < 0 || socket_path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "can't create socket " << socket_path << std::endl;
+        return;
+    }
+    socket_path.copy(address.sun_path, socket_path.size());
+    unlink(socket_path.c_str());
+    if (bind(listener, (sockaddr *) &address, sizeof(address)) < 0 || listen(listener, 64) < 0) {
+        std::cerr << "can't listen on " << socket_path << std::endl;
+        close(listener);
+        return;
+    }
+    while (true) {
+        int client = accept(listener, nullptr, nullptr);
+        if (client < 0) {
+            continue;
+        }
+        std::thread([this, client] {
+            FILE *in = fdopen(client, "r");
+            FILE *out = fdopen(dup(client), "w");
+            serveStream(in, out);
+            fclose(out);
+            fclose(in);
+        }).detach();
+    }
+}
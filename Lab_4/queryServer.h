@@ -0,0 +1,69 @@
+#ifndef Lab_4_QUERYSERVER_H
+#define Lab_4_QUERYSERVER_H
+
+#include <condition_variable>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include "graph.h"
+#include "pointToPoint.h"
+#include "contractionHierarchy.h"
+
+// keeps one graph resident and answers line queries: "s t" gives "s t dist", "s *" gives "s * " and all
+// distances from s, "stats" gives latency percentiles so far; queries of a session run concurrently
+// on the pool and answers are written in the order of the queries
+class QueryServer {
+public:
+    // hierarchy may be null, then s-t queries run dijkstra with early exit
+    QueryServer(const CsrGraph &graph, const ContractionHierarchy *hierarchy, int threads);
+
+    ~QueryServer();
+
+    // one session until in ends, the summary goes to stderr
+    void serveStream(FILE *in, FILE *out);
+
+    // accepts clients on a unix socket forever, each one is a session
+    void serveSocket(const std::string &socket_path);
+
+private:
+    // search state of one query, taken from the pool so that nothing of size n is allocated per query
+    struct Scratch {
+        SearchState forward;
+        SearchState backward;
+
+        explicit Scratch(int n) : forward(n), backward(n) {}
+    };
+
+    struct Session;
+
+    const CsrGraph &graph;
+    const ContractionHierarchy *hierarchy;
+
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex tasks_lock;
+    std::condition_variable tasks_ready;
+    bool stopping = false;
+
+    std::vector<std::unique_ptr<Scratch>> free_scratch;
+    std::mutex scratch_lock;
+
+    void work();
+
+    void submit(std::function<void()> task);
+
+    std::unique_ptr<Scratch> takeScratch();
+
+    void returnScratch(std::unique_ptr<Scratch> scratch);
+
+    std::string answer(const std::string &query, Session &session);
+
+    static std::string latencySummary(std::vector<double> latencies);
+};
+
+#endif
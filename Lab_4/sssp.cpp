@@ -0,0 +1,178 @@
+#include "sssp.h"
+#include "dHeap.h"
+#include "perfCounters.h"
+#include <algorithm>
+#include <omp.h>
+
+void dijkstraHeap(const CsrGraph &graph, int start, std::vector<int> &dist) {
+    PERF_REGION("dijkstraHeap");
+    dist.assign(graph.n, INF);
+    DHeap<4> heap(graph.n);
+    dist[start] = 0;
+    heap.pushOrDecrease(start, 0);
+    while (!heap.empty()) {
+        auto top = heap.pop();
+        int u = top.first;
+        int du = top.second;
+        for (int64_t e = graph.offsets[u]; e < graph.offsets[u + 1]; e++) {
+            int v = graph.targets[e];
+            int candidate = du + graph.weights[e];
+            if (candidate < dist[v]) {
+                dist[v] = candidate;
+                heap.pushOrDecrease(v, candidate);
+            }
+        }
+    }
+}
+
+void dijkstraDense(const DenseGraph &matrix, int start, std::vector<int> &dist,
+                   std::vector<int> &used) {
+    int n = matrix.n;
+    dist.assign(n, INF);
+    used.assign(n, 0);
+    dist[start] = 0;
+    for (int i = 0; i < n; i++) {
+        int nearest_k = -1;
+        for (int k = 0; k < n; k++) {
+            if (!used[k] && dist[k] != INF && (nearest_k < 0 || dist[k] < dist[nearest_k])) {
+                nearest_k = k;
+            }
+        }
+        if (nearest_k < 0) {
+            break;
+        }
+        used[nearest_k] = 1;
+        int base = dist[nearest_k];
+        const int *row = matrix[nearest_k];
+#pragma omp simd
+        for (int v = 0; v < n; v++) {
+            int candidate = row[v] >= 0 ? base + row[v] : INF;
+            dist[v] = candidate < dist[v] ? candidate : dist[v];
+        }
+    }
+}
+
+static int maxWeight(const CsrGraph &graph) {
+    int max_weight = 0;
+#pragma omp parallel for reduction(max: max_weight)
+    for (int64_t e = 0; e < graph.edges(); e++) {
+        max_weight = std::max(max_weight, graph.weights[e]);
+    }
+    return max_weight;
+}
+
+int chooseDelta(const CsrGraph &graph) {
+    if (graph.n == 0 || graph.edges() == 0) {
+        return 1;
+    }
+    double degree = (double) graph.edges() / graph.n;
+    return std::max(1, (int) (maxWeight(graph) / std::max(1.0, degree)));
+}
+
+// lowers target to value, true if this thread did it
+static bool atomicMin(int &target, int value) {
+    int current = __atomic_load_n(&target, __ATOMIC_RELAXED);
+    while (value < current) {
+        if (__atomic_compare_exchange_n(&target, &current, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// relaxes light (weight <= delta) or heavy edges of the frontier, improved vertices go to per-thread buffers
+static void relaxEdges(const CsrGraph &graph, const std::vector<int> &frontier, bool light, int delta,
+                       std::vector<int> &dist, std::vector<std::vector<int>> &buffers) {
+#pragma omp parallel
+    {
+        PERF_REGION("delta relax");
+        std::vector<int> &buffer = buffers[omp_get_thread_num()];
+#pragma omp for schedule(dynamic, 64)
+        for (int i = 0; i < (int) frontier.size(); i++) {
+            int u = frontier[i];
+            int du = __atomic_load_n(&dist[u], __ATOMIC_RELAXED);
+            for (int64_t e = graph.offsets[u]; e < graph.offsets[u + 1]; e++) {
+                int weight = graph.weights[e];
+                if ((weight <= delta) != light) {
+                    continue;
+                }
+                int v = graph.targets[e];
+                if (atomicMin(dist[v], du + weight)) {
+                    buffer.push_back(v);
+                }
+            }
+        }
+    }
+}
+
+void deltaStepping(const CsrGraph &graph, int start, std::vector<int> &dist, int delta) {
+    dist.assign(graph.n, INF);
+    if (delta <= 0) {
+        delta = chooseDelta(graph);
+    }
+
+    // pending vertices never lie further than max weight / delta buckets ahead, so a ring is enough
+    int ring = maxWeight(graph) / delta + 2;
+    std::vector<std::vector<int>> buckets(ring);
+    std::vector<std::vector<int>> buffers(omp_get_max_threads());
+    std::vector<int> stamp(graph.n, -1);
+    std::vector<int> frontier;
+    std::vector<int> settled;
+
+    dist[start] = 0;
+    buckets[0].push_back(start);
+
+    auto flushBuffers = [&]() {
+        for (std::vector<int> &buffer : buffers) {
+            for (int v : buffer) {
+                buckets[(dist[v] / delta) % ring].push_back(v);
+            }
+            buffer.clear();
+        }
+    };
+
+    int64_t current = 0;
+    while (true) {
+        int skipped = 0;
+        while (skipped < ring && buckets[current % ring].empty()) {
+            current++;
+            skipped++;
+        }
+        if (skipped == ring) {
+            break;
+        }
+
+        // light edges can refill the current bucket, repeat until it stays empty
+        settled.clear();
+        std::vector<int> &bucket = buckets[current % ring];
+        while (!bucket.empty()) {
+            frontier.clear();
+            for (int v : bucket) {
+                // skip entries that moved to a lower bucket and duplicates within this round
+                if (dist[v] / delta == current && stamp[v] != current) {
+                    stamp[v] = current;
+                    frontier.push_back(v);
+                    settled.push_back(v);
+                }
+            }
+            bucket.clear();
+            relaxEdges(graph, frontier, true, delta, dist, buffers);
+            // a vertex relaxed again must be rescanned
+            for (std::vector<int> &buffer : buffers) {
+                for (int v : buffer) {
+                    if (dist[v] / delta == current) {
+                        stamp[v] = -1;
+                    }
+                }
+            }
+            flushBuffers();
+        }
+
+        // heavy edges always leave the bucket, one pass over everything settled in it
+        std::sort(settled.begin(), settled.end());
+        settled.erase(std::unique(settled.begin(), settled.end()), settled.end());
+        relaxEdges(graph, settled, false, delta, dist, buffers);
+        flushBuffers();
+        current++;
+    }
+}
@@ -0,0 +1,20 @@
+#ifndef Lab_4_SSSP_H
+#define Lab_4_SSSP_H
+
+#include <vector>
+#include "graph.h"
+
+// O(m log n) dijkstra with a 4-ary heap, unreachable vertices get INF
+void dijkstraHeap(const CsrGraph &graph, int start, std::vector<int> &dist);
+
+// serial O(n^2) dijkstra on a matrix with caller-owned state, used by batched queries
+void dijkstraDense(const DenseGraph &matrix, int start, std::vector<int> &dist,
+                   std::vector<int> &used);
+
+// parallel delta-stepping, vertices are bucketed by dist / delta and a whole bucket is relaxed at once
+void deltaStepping(const CsrGraph &graph, int start, std::vector<int> &dist, int delta);
+
+// max weight / average degree, so a bucket holds about one hop of work per vertex
+int chooseDelta(const CsrGraph &graph);
+
+#endif
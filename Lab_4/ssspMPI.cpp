@@ -0,0 +1,547 @@
+#include "ssspMPI.h"
+#include "perfCountersMPI.h"
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+SsspMPI::SsspMPI(int argc, char **argv) : argc(argc), argv(argv) {
+    MPI_Init(&argc, &argv);
+    MPI_Comm_size(MPI_COMM_WORLD, &MPI_size);
+    MPI_Comm_rank(MPI_COMM_WORLD, &MPI_rank);
+}
+
+SsspMPI::~SsspMPI() {
+    perf::reportMPI(MPI_COMM_WORLD, MAIN_PROCESS, std::cerr);
+    MPI_Finalize();
+}
+
+double SsspMPI::run() {
+    if (argc < 4) {
+        if (MPI_rank == MAIN_PROCESS) {
+            std::cout << "usage: path1 start path2 [options]\n"
+                         "path1 - csr graph snapshot (Lab_4 --to-binary=csr or --to-binary here),\n"
+                         "        every process reads its block\n"
+                         "start - first vertex\n"
+                         "path2 - path to output distances\n"
+                         "options:\n"
+                         "--format=edges - path1 is \"n m\" and m lines \"from to weight\", every process parses\n"
+                         "                 a part of the file and keeps only the edges of its vertices\n"
+                         "--to-binary - with --format=edges write the distributed graph as a csr snapshot\n"
+                         "              to path2 and exit, start is ignored\n"
+                         "--delta=D - bucket width, 0 picks it from weights and degree (default)\n"
+                         "--binary-output - every process writes its block straight to path2\n"
+                         "                  (binary: header and int32 distances) instead of gathering on one process\n";
+        }
+        return -1;
+    }
+    start = atoi(argv[2]);
+    readOptions();
+    if (to_binary && !edges_input) {
+        if (MPI_rank == MAIN_PROCESS) {
+            std::cout << "--to-binary needs --format=edges\n";
+        }
+        return -1;
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    double load_time = MPI_Wtime();
+    if (!(edges_input ? readEdgesParallel(argv[1]) : readGraphParallel(argv[1]))) {
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    if (to_binary) {
+        writeSnapshotParallel(argv[3]);
+        if (MPI_rank == MAIN_PROCESS) {
+            calc_time = MPI_Wtime() - load_time;
+        }
+        return calc_time;
+    }
+    if (start < 0 || start >= n) {
+        if (MPI_rank == MAIN_PROCESS) {
+            std::cout << "start is out of range\n";
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+    double start_time = MPI_Wtime();
+    solve();
+    double end_time = MPI_Wtime();
+
+    if (binary_output) {
+        writeResultParallel(argv[3]);
+    } else {
+        writeResult(argv[3]);
+    }
+    if (MPI_rank == MAIN_PROCESS) {
+        calc_time = end_time - start_time;
+    }
+    return calc_time;
+}
+
+void SsspMPI::readOptions() {
+    for (int i = 4; i < argc; i++) {
+        std::string option = argv[i];
+        if (option.compare(0, 8, "--delta=") == 0) {
+            delta = atoi(option.c_str() + 8);
+        } else if (option == "--binary-output") {
+            binary_output = true;
+        } else if (option == "--format=edges") {
+            edges_input = true;
+        } else if (option == "--to-binary") {
+            to_binary = true;
+        } else if (MPI_rank == MAIN_PROCESS) {
+            std::cout << "unknown option: " << option << "\n";
+        }
+    }
+}
+
+std::pair<int, int> SsspMPI::countProcessBounds(int process) {
+    int rem = n % MPI_size;
+    int start;
+    int end;
+    if (rem > process) {
+        start = (part + 1) * process;
+        end = start + (part + 1);
+    } else {
+        start = (part + 1) * rem + part * (process - rem);
+        end = start + part;
+    }
+    return {start, end};
+}
+
+int SsspMPI::ownerOf(int vertex) {
+    int rem = n % MPI_size;
+    int big = (part + 1) * rem;
+    if (vertex < big) {
+        return vertex / (part + 1);
+    }
+    return rem + (vertex - big) / part;
+}
+
+bool SsspMPI::readGraphParallel(const std::string &in_path) {
+    MPI_File file;
+    if (MPI_File_open(MPI_COMM_WORLD, in_path.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+        if (MPI_rank == MAIN_PROCESS) {
+            std::cout << "can't open " << in_path << "\n";
+        }
+        return false;
+    }
+    GraphFileHeader header;
+    MPI_File_read_at_all(file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+    if (memcmp(header.magic, CSR_MAGIC, sizeof(header.magic)) != 0) {
+        if (MPI_rank == MAIN_PROCESS) {
+            std::cout << in_path << " is not a csr snapshot\n";
+        }
+        MPI_File_close(&file);
+        return false;
+    }
+    MPI_Offset file_size;
+    MPI_File_get_size(file, &file_size);
+    if (file_size < (MPI_Offset) sizeof(header) || !snapshotFits(header, false, file_size - sizeof(header))) {
+        if (MPI_rank == MAIN_PROCESS) {
+            std::cout << "bad header or truncated snapshot " << in_path << "\n";
+        }
+        MPI_File_close(&file);
+        return false;
+    }
+    m = header.m;
+    splitVertices(header.n);
+
+    MPI_Offset offsets_at = sizeof(header);
+    MPI_Offset targets_at = offsets_at + (MPI_Offset) (n + 1) * sizeof(int64_t);
+    MPI_Offset weights_at = targets_at + (MPI_Offset) m * sizeof(int);
+
+    offsets.resize(vertex_to - vertex_from + 1);
+    MPI_File_read_at_all(file, offsets_at + (MPI_Offset) vertex_from * sizeof(int64_t), offsets.data(),
+                         offsets.size(), MPI_INT64_T, MPI_STATUS_IGNORE);
+    int64_t first_edge = offsets[0];
+    int64_t edges = offsets.back() - first_edge;
+    // the first rank holds offsets[0], the last one offsets[n], the slices in between must not run backwards
+    int local_valid = edges >= 0 && first_edge >= 0 && offsets.back() <= m &&
+                      (vertex_from != 0 || first_edge == 0) && (vertex_to != n || offsets.back() == m);
+    int all_valid;
+    MPI_Allreduce(&local_valid, &all_valid, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (!all_valid) {
+        if (MPI_rank == MAIN_PROCESS) {
+            std::cout << "offsets of " << in_path << " don't match its " << m << " edges\n";
+        }
+        MPI_File_close(&file);
+        return false;
+    }
+    for (int64_t &offset : offsets) {
+        offset -= first_edge;
+    }
+    targets.resize(edges);
+    weights.resize(edges);
+    MPI_File_read_at_all(file, targets_at + first_edge * sizeof(int), targets.data(), edges, MPI_INT,
+                         MPI_STATUS_IGNORE);
+    MPI_File_read_at_all(file, weights_at + first_edge * sizeof(int), weights.data(), edges, MPI_INT,
+                         MPI_STATUS_IGNORE);
+    MPI_File_close(&file);
+    return true;
+}
+
+void SsspMPI::splitVertices(int vertices) {
+    n = vertices;
+    part = n / MPI_size;
+    auto bounds = countProcessBounds(MPI_rank);
+    vertex_from = bounds.first;
+    vertex_to = bounds.second;
+}
+
+bool SsspMPI::readEdgesParallel(const std::string &in_path) {
+    static const int HEADER_BYTES = 64;
+    static const int TAIL_BYTES = 256;
+    MPI_File file;
+    if (MPI_File_open(MPI_COMM_WORLD, in_path.c_str(), MPI_MODE_RDONLY, MPI_INFO_NULL, &file) != MPI_SUCCESS) {
+        if (MPI_rank == MAIN_PROCESS) {
+            std::cout << "can't open " << in_path << "\n";
+        }
+        return false;
+    }
+    MPI_Offset file_size;
+    MPI_File_get_size(file, &file_size);
+
+    // "n m" line, the edges start after it
+    int64_t header[2] = {0, 0};
+    if (MPI_rank == MAIN_PROCESS) {
+        char line[HEADER_BYTES + 1] = {};
+        MPI_File_read_at(file, 0, line, std::min<MPI_Offset>(HEADER_BYTES, file_size), MPI_CHAR, MPI_STATUS_IGNORE);
+        char *end;
+        n = strtol(line, &end, 10);
+        char *line_end = strchr(line, '\n');
+        header[0] = n;
+        header[1] = line_end ? line_end + 1 - line : file_size;
+    }
+    MPI_Bcast(header, 2, MPI_INT64_T, MAIN_PROCESS, MPI_COMM_WORLD);
+    splitVertices(header[0]);
+    MPI_Offset body = header[1];
+
+    // the range is widened by one byte before it, a line belongs to the process where it starts,
+    // the last line is finished past the end of the range
+    MPI_Offset from = body + (file_size - body) * MPI_rank / MPI_size;
+    MPI_Offset to = body + (file_size - body) * (MPI_rank + 1) / MPI_size;
+    MPI_Offset read_from = from > body ? from - 1 : from;
+    std::vector<char> text(to - read_from);
+    MPI_File_read_at_all(file, read_from, text.data(), text.size(), MPI_CHAR, MPI_STATUS_IGNORE);
+    for (MPI_Offset at = to; at < file_size && (text.empty() || text.back() != '\n');) {
+        char tail[TAIL_BYTES];
+        int count = std::min<MPI_Offset>(TAIL_BYTES, file_size - at);
+        MPI_File_read_at(file, at, tail, count, MPI_CHAR, MPI_STATUS_IGNORE);
+        char *newline = (char *) memchr(tail, '\n', count);
+        int taken = newline ? newline + 1 - tail : count;
+        text.insert(text.end(), tail, tail + taken);
+        at += taken;
+    }
+    MPI_File_close(&file);
+    text.push_back('\0');
+
+    size_t position = 0;
+    if (from > body) {
+        // a line that started in the previous range is parsed there
+        const char *newline = (const char *) memchr(text.data(), '\n', text.size());
+        position = newline ? newline + 1 - text.data() : text.size() - 1;
+    }
+
+    // (from, to, weight) triples per owner of the source
+    std::vector<std::vector<int>> outgoing(MPI_size);
+    const char *cursor = text.data() + position;
+    bool valid = true;
+    while (true) {
+        char *end;
+        long u = strtol(cursor, &end, 10);
+        if (end == cursor) {
+            break;
+        }
+        long v = strtol(end, &end, 10);
+        long weight = strtol(end, &end, 10);
+        cursor = end;
+        if (u < 0 || u >= n || v < 0 || v >= n) {
+            valid = false;
+            continue;
+        }
+        std::vector<int> &buffer = outgoing[ownerOf(u)];
+        buffer.push_back(u);
+        buffer.push_back(v);
+        buffer.push_back(weight);
+    }
+    std::vector<char>().swap(text);
+
+    int all_valid;
+    int local_valid = valid;
+    MPI_Allreduce(&local_valid, &all_valid, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (!all_valid) {
+        if (MPI_rank == MAIN_PROCESS) {
+            std::cout << in_path << " has edges with vertices out of range\n";
+        }
+        return false;
+    }
+
+    send_counts.assign(MPI_size, 0);
+    send_displs.assign(MPI_size, 0);
+    recv_counts.assign(MPI_size, 0);
+    recv_displs.assign(MPI_size, 0);
+    send_data.clear();
+    for (int process = 0; process < MPI_size; process++) {
+        send_counts[process] = outgoing[process].size();
+        send_displs[process] = send_data.size();
+        send_data.insert(send_data.end(), outgoing[process].begin(), outgoing[process].end());
+        std::vector<int>().swap(outgoing[process]);
+    }
+    MPI_Alltoall(send_counts.data(), 1, MPI_INT, recv_counts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    int received = 0;
+    for (int process = 0; process < MPI_size; process++) {
+        recv_displs[process] = received;
+        received += recv_counts[process];
+    }
+    recv_data.resize(received);
+    MPI_Alltoallv(send_data.data(), send_counts.data(), send_displs.data(), MPI_INT,
+                  recv_data.data(), recv_counts.data(), recv_displs.data(), MPI_INT, MPI_COMM_WORLD);
+    std::vector<int>().swap(send_data);
+
+    // pieces arrive in file order, the counting sort by source keeps it like the sequential reader does
+    int64_t edges = received / 3;
+    offsets.assign(vertex_to - vertex_from + 1, 0);
+    for (int64_t e = 0; e < edges; e++) {
+        offsets[recv_data[3 * e] - vertex_from + 1]++;
+    }
+    for (int v = 0; v < vertex_to - vertex_from; v++) {
+        offsets[v + 1] += offsets[v];
+    }
+    std::vector<int64_t> position_of(offsets.begin(), offsets.end() - 1);
+    targets.resize(edges);
+    weights.resize(edges);
+    for (int64_t e = 0; e < edges; e++) {
+        int64_t slot = position_of[recv_data[3 * e] - vertex_from]++;
+        targets[slot] = recv_data[3 * e + 1];
+        weights[slot] = recv_data[3 * e + 2];
+    }
+    std::vector<int>().swap(recv_data);
+
+    MPI_Allreduce(&edges, &m, 1, MPI_INT64_T, MPI_SUM, MPI_COMM_WORLD);
+    return true;
+}
+
+void SsspMPI::writeSnapshotParallel(const std::string &out_path) {
+    MPI_File file;
+    if (MPI_File_open(MPI_COMM_WORLD, out_path.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file) !=
+        MPI_SUCCESS) {
+        if (MPI_rank == MAIN_PROCESS) {
+            std::cout << "can't open " << out_path << "\n";
+        }
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_File_set_size(file, 0);
+    if (MPI_rank == MAIN_PROCESS) {
+        GraphFileHeader header;
+        memcpy(header.magic, CSR_MAGIC, sizeof(header.magic));
+        header.n = n;
+        header.m = m;
+        MPI_File_write_at(file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+
+    int64_t edges = offsets.back();
+    int64_t first_edge = 0;
+    MPI_Exscan(&edges, &first_edge, 1, MPI_INT64_T, MPI_SUM, MPI_COMM_WORLD);
+    if (MPI_rank == MAIN_PROCESS) {
+        first_edge = 0;
+    }
+    // the end offset of the block is the start of the next one, only the last process writes it
+    std::vector<int64_t> global(offsets.size());
+    for (size_t v = 0; v < offsets.size(); v++) {
+        global[v] = offsets[v] + first_edge;
+    }
+    int count = vertex_to - vertex_from + (MPI_rank == MPI_size - 1 ? 1 : 0);
+
+    MPI_Offset offsets_at = sizeof(GraphFileHeader);
+    MPI_Offset targets_at = offsets_at + (MPI_Offset) (n + 1) * sizeof(int64_t);
+    MPI_Offset weights_at = targets_at + (MPI_Offset) m * sizeof(int);
+    MPI_File_write_at_all(file, offsets_at + (MPI_Offset) vertex_from * sizeof(int64_t), global.data(), count,
+                          MPI_INT64_T, MPI_STATUS_IGNORE);
+    MPI_File_write_at_all(file, targets_at + first_edge * sizeof(int), targets.data(), edges, MPI_INT,
+                          MPI_STATUS_IGNORE);
+    MPI_File_write_at_all(file, weights_at + first_edge * sizeof(int), weights.data(), edges, MPI_INT,
+                          MPI_STATUS_IGNORE);
+    MPI_File_close(&file);
+}
+
+void SsspMPI::chooseDelta() {
+    int local_max = 0;
+    for (int weight : weights) {
+        local_max = std::max(local_max, weight);
+    }
+    int max_weight;
+    MPI_Allreduce(&local_max, &max_weight, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+    if (delta <= 0) {
+        // max weight / average degree, as in the shared memory engine
+        double degree = n > 0 ? (double) m / n : 0;
+        delta = std::max(1, (int) (max_weight / std::max(1.0, degree)));
+    }
+    // pending vertices never lie further than max weight / delta buckets ahead
+    ring = max_weight / delta + 2;
+}
+
+void SsspMPI::improve(int local, int candidate, int64_t current) {
+    if (candidate >= dist[local]) {
+        return;
+    }
+    dist[local] = candidate;
+    int64_t bucket = candidate / delta;
+    buckets[bucket % ring].push_back(local);
+    // a vertex improved again within the current bucket has to be rescanned
+    if (bucket == current) {
+        stamp[local] = -1;
+    }
+}
+
+void SsspMPI::relaxAndExchange(const std::vector<int> &frontier, bool light, int64_t current) {
+    for (std::vector<int> &buffer : send_buffers) {
+        buffer.clear();
+    }
+    {
+        PERF_REGION("relax");
+        for (int u : frontier) {
+            int du = dist[u];
+            for (int64_t e = offsets[u]; e < offsets[u + 1]; e++) {
+                int weight = weights[e];
+                if ((weight <= delta) != light) {
+                    continue;
+                }
+                int v = targets[e];
+                int owner = ownerOf(v);
+                if (owner == MPI_rank) {
+                    improve(v - vertex_from, du + weight, current);
+                } else {
+                    send_buffers[owner].push_back(v);
+                    send_buffers[owner].push_back(du + weight);
+                }
+            }
+        }
+    }
+
+    send_data.clear();
+    for (int process = 0; process < MPI_size; process++) {
+        send_counts[process] = send_buffers[process].size();
+        send_displs[process] = send_data.size();
+        send_data.insert(send_data.end(), send_buffers[process].begin(), send_buffers[process].end());
+    }
+    MPI_Alltoall(send_counts.data(), 1, MPI_INT, recv_counts.data(), 1, MPI_INT, MPI_COMM_WORLD);
+    int received = 0;
+    for (int process = 0; process < MPI_size; process++) {
+        recv_displs[process] = received;
+        received += recv_counts[process];
+    }
+    recv_data.resize(received);
+    MPI_Alltoallv(send_data.data(), send_counts.data(), send_displs.data(), MPI_INT,
+                  recv_data.data(), recv_counts.data(), recv_displs.data(), MPI_INT, MPI_COMM_WORLD);
+    for (int i = 0; i < received; i += 2) {
+        improve(recv_data[i] - vertex_from, recv_data[i + 1], current);
+    }
+}
+
+void SsspMPI::solve() {
+    chooseDelta();
+    dist.assign(vertex_to - vertex_from, INF);
+    buckets.assign(ring, std::vector<int>());
+    stamp.assign(vertex_to - vertex_from, -1);
+    send_buffers.assign(MPI_size, std::vector<int>());
+    send_counts.resize(MPI_size);
+    recv_counts.resize(MPI_size);
+    send_displs.resize(MPI_size);
+    recv_displs.resize(MPI_size);
+
+    if (ownerOf(start) == MPI_rank) {
+        improve(start - vertex_from, 0, 0);
+    }
+
+    std::vector<int> frontier;
+    std::vector<int> settled;
+    int64_t current = 0;
+    while (true) {
+        // the next bucket is the lowest nonempty one over all processes
+        int64_t local_next = LLONG_MAX;
+        for (int j = 0; j < ring; j++) {
+            if (!buckets[(current + j) % ring].empty()) {
+                local_next = current + j;
+                break;
+            }
+        }
+        MPI_Allreduce(&local_next, &current, 1, MPI_INT64_T, MPI_MIN, MPI_COMM_WORLD);
+        if (current == LLONG_MAX) {
+            break;
+        }
+
+        // light edges can refill the bucket on any process, repeat until it is empty everywhere
+        settled.clear();
+        std::vector<int> &bucket = buckets[current % ring];
+        while (true) {
+            frontier.clear();
+            for (int v : bucket) {
+                if (dist[v] / delta == current && stamp[v] != current) {
+                    stamp[v] = current;
+                    frontier.push_back(v);
+                    settled.push_back(v);
+                }
+            }
+            bucket.clear();
+            relaxAndExchange(frontier, true, current);
+            int local_more = !bucket.empty();
+            int more;
+            MPI_Allreduce(&local_more, &more, 1, MPI_INT, MPI_LOR, MPI_COMM_WORLD);
+            if (!more) {
+                break;
+            }
+        }
+
+        std::sort(settled.begin(), settled.end());
+        settled.erase(std::unique(settled.begin(), settled.end()), settled.end());
+        relaxAndExchange(settled, false, current);
+        current++;
+    }
+}
+
+void SsspMPI::writeResult(const std::string &out_path) {
+    std::vector<int> counts(MPI_size);
+    std::vector<int> displs(MPI_size);
+    for (int process = 0; process < MPI_size; process++) {
+        auto bounds = countProcessBounds(process);
+        displs[process] = bounds.first;
+        counts[process] = bounds.second - bounds.first;
+    }
+    std::vector<int> full;
+    if (MPI_rank == MAIN_PROCESS) {
+        full.resize(n);
+    }
+    MPI_Gatherv(dist.data(), dist.size(), MPI_INT, full.data(), counts.data(), displs.data(), MPI_INT,
+                MAIN_PROCESS, MPI_COMM_WORLD);
+    if (MPI_rank != MAIN_PROCESS) {
+        return;
+    }
+    std::ofstream out(out_path);
+    for (int i = 0; i < n; i++) {
+        if (full[i] == INF) {
+            out << "INF ";
+        } else {
+            out << full[i] << " ";
+        }
+    }
+}
+
+void SsspMPI::writeResultParallel(const std::string &out_path) {
+    MPI_File file;
+    MPI_File_open(MPI_COMM_WORLD, out_path.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &file);
+    MPI_File_set_size(file, 0);
+    DistFileHeader header;
+    memcpy(header.magic, DIST_MAGIC, sizeof(header.magic));
+    header.rows = 1;
+    header.cols = n;
+    if (MPI_rank == MAIN_PROCESS) {
+        MPI_File_write_at(file, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+    }
+    MPI_File_write_at_all(file, sizeof(header) + (MPI_Offset) vertex_from * sizeof(int), dist.data(), dist.size(),
+                          MPI_INT, MPI_STATUS_IGNORE);
+    MPI_File_close(&file);
+}
@@ -0,0 +1,109 @@
+#ifndef Lab_4_SSSPMPI_H
+#define Lab_4_SSSPMPI_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "mpi.h"
+#include "graph.h"
+
+// delta-stepping on a graph split into contiguous vertex blocks, every process owns dist and outgoing
+// edges of its block; relaxations of a phase are aggregated per owner and exchanged with one MPI_Alltoallv
+class SsspMPI {
+public:
+    SsspMPI(int argc, char **argv);
+
+    ~SsspMPI();
+
+    // calculation time on the main process, -1 on the others
+    double run();
+
+    int vertices() const {
+        return n;
+    }
+
+    int processes() const {
+        return MPI_size;
+    }
+
+private:
+
+    enum consts {
+        MAIN_PROCESS = 0,
+    };
+
+    int argc;
+    char **argv;
+
+    int MPI_size;
+    int MPI_rank;
+
+    int n = 0;
+    int64_t m = 0;
+    int part = 0;
+    int vertex_from = 0;
+    int vertex_to = 0;
+
+    // edges of the own block, offsets are relative to its first edge
+    std::vector<int64_t> offsets;
+    std::vector<int> targets;
+    std::vector<int> weights;
+    // dist of the own block
+    std::vector<int> dist;
+
+    int start = 0;
+    int delta = 0;
+    bool binary_output = false;
+    bool edges_input = false;
+    bool to_binary = false;
+
+    // ring of buckets by dist / delta holding local vertex indices
+    std::vector<std::vector<int>> buckets;
+    int ring = 0;
+    std::vector<int64_t> stamp;
+
+    // (vertex, dist) pairs per destination process
+    std::vector<std::vector<int>> send_buffers;
+    std::vector<int> send_counts;
+    std::vector<int> recv_counts;
+    std::vector<int> send_displs;
+    std::vector<int> recv_displs;
+    std::vector<int> send_data;
+    std::vector<int> recv_data;
+
+    double calc_time = -1;
+
+    void readOptions();
+
+    std::pair<int, int> countProcessBounds(int process);
+
+    int ownerOf(int vertex);
+
+    // every process reads its block of a csr snapshot with MPI-IO
+    bool readGraphParallel(const std::string &in_path);
+
+    // every process parses a byte range of a text edge list, edges are sent to the owners of their sources,
+    // so no process ever holds more than its share of the file and of the graph
+    bool readEdgesParallel(const std::string &in_path);
+
+    // sets n and the bounds of the own block
+    void splitVertices(int vertices);
+
+    // csr snapshot of the distributed graph, every process writes its block
+    void writeSnapshotParallel(const std::string &out_path);
+
+    void chooseDelta();
+
+    void solve();
+
+    // relaxes light or heavy edges of the local frontier and applies the requests other processes sent here
+    void relaxAndExchange(const std::vector<int> &frontier, bool light, int64_t current);
+
+    void improve(int local, int candidate, int64_t current);
+
+    void writeResult(const std::string &out_path);
+
+    void writeResultParallel(const std::string &out_path);
+};
+
+#endif
@@ -0,0 +1,253 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+// hardware counters of code regions: PERF_REGION("name") at the top of a block counts cycles, instructions,
+// last level cache misses and branch misses of the calling thread until the block ends; totals of every
+// thread that entered a region are merged under its name. Compiled in only with PERF_COUNTERS defined
+// (cmake -DPERF_COUNTERS=ON), otherwise regions and reports expand to nothing.
+
+#include <iosfwd>
+
+#ifdef PERF_COUNTERS
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace perf {
+    enum counters {
+        CYCLES,
+        INSTRUCTIONS,
+        LLC_MISSES,
+        BRANCH_MISSES,
+        COUNTERS
+    };
+
+    static const char *const COUNTER_NAMES[COUNTERS] = {"cycles", "instructions", "llc-misses", "branch-misses"};
+
+    // sums over every thread and call of the region
+    struct Totals {
+        std::string name;
+        uint64_t values[COUNTERS] = {};
+        uint64_t calls = 0;
+        uint64_t nanoseconds = 0;
+
+        void add(const Totals &other) {
+            for (int counter = 0; counter < COUNTERS; counter++) {
+                values[counter] += other.values[counter];
+            }
+            calls += other.calls;
+            nanoseconds += other.nanoseconds;
+        }
+    };
+
+    // one per PERF_REGION site, registered on first entry
+    struct Region {
+        const char *name;
+        std::atomic<uint64_t> values[COUNTERS];
+        std::atomic<uint64_t> calls;
+        std::atomic<uint64_t> nanoseconds;
+
+        explicit Region(const char *name);
+    };
+
+    inline std::vector<Region *> &regions() {
+        static std::vector<Region *> all;
+        return all;
+    }
+
+    inline std::mutex &regionsLock() {
+        static std::mutex lock;
+        return lock;
+    }
+
+    inline Region::Region(const char *name) : name(name) {
+        for (std::atomic<uint64_t> &value : values) {
+            value.store(0);
+        }
+        calls.store(0);
+        nanoseconds.store(0);
+        std::lock_guard<std::mutex> guard(regionsLock());
+        regions().push_back(this);
+    }
+
+    // group of counters of the calling thread, read with one system call;
+    // without perf events (other os, paranoid kernel, no pmu in a vm) only calls and time are kept
+    class ThreadCounters {
+    public:
+        bool available = false;
+
+        ThreadCounters() {
+#ifdef __linux__
+            static const uint64_t configs[COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                       PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+            for (int counter = 0; counter < COUNTERS; counter++) {
+                perf_event_attr attr;
+                memset(&attr, 0, sizeof(attr));
+                attr.size = sizeof(attr);
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = configs[counter];
+                attr.read_format = PERF_FORMAT_GROUP;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                int leader = counter == 0 ? -1 : fds[0];
+                fds[counter] = syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+                if (fds[counter] < 0) {
+                    closeFirst(counter);
+                    return;
+                }
+            }
+            available = true;
+#endif
+        }
+
+        ~ThreadCounters() {
+            closeFirst(available ? COUNTERS : 0);
+        }
+
+        void read(uint64_t *values) const {
+#ifdef __linux__
+            struct {
+                uint64_t count;
+                uint64_t values[COUNTERS];
+            } group;
+            if (available && ::read(fds[0], &group, sizeof(group)) == sizeof(group)) {
+                memcpy(values, group.values, sizeof(group.values));
+                return;
+            }
+#endif
+            memset(values, 0, COUNTERS * sizeof(uint64_t));
+        }
+
+    private:
+        int fds[COUNTERS] = {};
+
+        // closes the first opened descriptors
+        void closeFirst(int opened) {
+#ifdef __linux__
+            for (int counter = 0; counter < opened; counter++) {
+                ::close(fds[counter]);
+            }
+#endif
+        }
+    };
+
+    inline const ThreadCounters &threadCounters() {
+        thread_local ThreadCounters counters;
+        return counters;
+    }
+
+    class Scope {
+    public:
+        explicit Scope(Region &region) : region(region) {
+            threadCounters().read(start);
+            begin = std::chrono::steady_clock::now();
+        }
+
+        ~Scope() {
+            uint64_t end[COUNTERS];
+            threadCounters().read(end);
+            auto elapsed = std::chrono::steady_clock::now() - begin;
+            for (int counter = 0; counter < COUNTERS; counter++) {
+                region.values[counter].fetch_add(end[counter] - start[counter], std::memory_order_relaxed);
+            }
+            region.calls.fetch_add(1, std::memory_order_relaxed);
+            region.nanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(),
+                                         std::memory_order_relaxed);
+        }
+
+    private:
+        Region &region;
+        uint64_t start[COUNTERS];
+        std::chrono::steady_clock::time_point begin;
+    };
+
+    // regions of this process merged by name
+    inline std::vector<Totals> collect() {
+        std::map<std::string, Totals> merged;
+        std::lock_guard<std::mutex> guard(regionsLock());
+        for (Region *region : regions()) {
+            Totals totals;
+            totals.name = region->name;
+            for (int counter = 0; counter < COUNTERS; counter++) {
+                totals.values[counter] = region->values[counter].load();
+            }
+            totals.calls = region->calls.load();
+            totals.nanoseconds = region->nanoseconds.load();
+            Totals &entry = merged[totals.name];
+            entry.name = totals.name;
+            entry.add(totals);
+        }
+        std::vector<Totals> all;
+        for (auto &entry : merged) {
+            all.push_back(entry.second);
+        }
+        return all;
+    }
+
+    // time is summed over threads, ipc and miss rates tell compute bound from memory bound regions
+    inline void print(std::ostream &out, const std::vector<Totals> &all) {
+        out << std::left << std::setw(24) << "region" << std::right << std::setw(10) << "calls" << std::setw(12)
+            << "thread-s";
+        for (const char *name : COUNTER_NAMES) {
+            out << std::setw(16) << name;
+        }
+        out << std::setw(8) << "ipc" << std::setw(12) << "llc/kinst" << "\n";
+        for (const Totals &totals : all) {
+            out << std::left << std::setw(24) << totals.name << std::right << std::setw(10) << totals.calls
+                << std::setw(12) << std::fixed << std::setprecision(4) << totals.nanoseconds * 1e-9;
+            for (uint64_t value : totals.values) {
+                out << std::setw(16) << value;
+            }
+            uint64_t cycles = totals.values[CYCLES];
+            uint64_t instructions = totals.values[INSTRUCTIONS];
+            if (cycles == 0 || instructions == 0) {
+                out << std::setw(8) << "-" << std::setw(12) << "-" << "\n";
+                continue;
+            }
+            out << std::setw(8) << std::setprecision(2) << (double) instructions / cycles << std::setw(12)
+                << std::setprecision(3) << 1000.0 * totals.values[LLC_MISSES] / instructions << "\n";
+        }
+        out.unsetf(std::ios::floatfield);
+        out << std::setprecision(6);
+        if (!threadCounters().available) {
+            out << "perf events are not available, only calls and time are counted\n";
+        }
+    }
+
+    inline void report(std::ostream &out) {
+        print(out, collect());
+    }
+}
+
+#define PERF_CONCAT_(a, b) a##b
+#define PERF_CONCAT(a, b) PERF_CONCAT_(a, b)
+#define PERF_REGION(name) \
+    static perf::Region PERF_CONCAT(perf_region_, __LINE__)(name); \
+    perf::Scope PERF_CONCAT(perf_scope_, __LINE__)(PERF_CONCAT(perf_region_, __LINE__))
+
+#else
+
+namespace perf {
+    inline void report(std::ostream &) {}
+}
+
+#define PERF_REGION(name) do {} while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef PERF_COUNTERS_MPI_H
+#define PERF_COUNTERS_MPI_H
+
+#include "perfCounters.h"
+#include "mpi.h"
+
+#ifdef PERF_COUNTERS
+
+namespace perf {
+    // collective, regions of all processes of comm are merged by name and printed on root
+    inline void reportMPI(MPI_Comm comm, int root, std::ostream &out) {
+        int rank;
+        int size;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &size);
+
+        // name with its terminating zero, then the numbers of each region
+        std::vector<char> packed;
+        for (const Totals &totals : collect()) {
+            packed.insert(packed.end(), totals.name.c_str(), totals.name.c_str() + totals.name.size() + 1);
+            uint64_t numbers[COUNTERS + 2];
+            memcpy(numbers, totals.values, sizeof(totals.values));
+            numbers[COUNTERS] = totals.calls;
+            numbers[COUNTERS + 1] = totals.nanoseconds;
+            const char *bytes = (const char *) numbers;
+            packed.insert(packed.end(), bytes, bytes + sizeof(numbers));
+        }
+
+        int packed_size = packed.size();
+        std::vector<int> sizes(size);
+        MPI_Gather(&packed_size, 1, MPI_INT, sizes.data(), 1, MPI_INT, root, comm);
+        std::vector<int> displs(size);
+        int total = 0;
+        for (int process = 0; process < size; process++) {
+            displs[process] = total;
+            total += sizes[process];
+        }
+        std::vector<char> all(rank == root ? total : 0);
+        MPI_Gatherv(packed.data(), packed_size, MPI_CHAR, all.data(), sizes.data(), displs.data(), MPI_CHAR, root,
+                    comm);
+        if (rank != root) {
+            return;
+        }
+
+        std::map<std::string, Totals> merged;
+        size_t position = 0;
+        while (position < all.size()) {
+            Totals totals;
+            totals.name = all.data() + position;
+            position += totals.name.size() + 1;
+            uint64_t numbers[COUNTERS + 2];
+            memcpy(numbers, all.data() + position, sizeof(numbers));
+            position += sizeof(numbers);
+            memcpy(totals.values, numbers, sizeof(totals.values));
+            totals.calls = numbers[COUNTERS];
+            totals.nanoseconds = numbers[COUNTERS + 1];
+            Totals &entry = merged[totals.name];
+            entry.name = totals.name;
+            entry.add(totals);
+        }
+        std::vector<Totals> regions;
+        for (auto &entry : merged) {
+            regions.push_back(entry.second);
+        }
+        out << "counters of " << size << " processes\n";
+        print(out, regions);
+    }
+}
+
+#else
+
+namespace perf {
+    inline void reportMPI(MPI_Comm, int, std::ostream &) {}
+}
+
+#endif
+
+#endif
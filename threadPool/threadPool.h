@@ -0,0 +1,290 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+// persistent pinned workers for short parallel loops. Threads are started once, a loop is published by bumping
+// a generation counter the workers watch, so a dispatch costs a few cache line transfers instead of an OpenMP
+// fork/join. Idle workers spin for a while to pick the next loop up at once, then park on a condition variable.
+// The calling thread runs as thread 0 of every loop; loops started from inside a loop or while another
+// thread owns the pool run serially on the caller.
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+namespace pool {
+    enum schedules {
+        STATIC, DYNAMIC, GUIDED
+    };
+
+    // pause between polls, keeps the sibling hyperthread going
+    inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+
+    inline bool &insideLoop() {
+        thread_local bool inside = false;
+        return inside;
+    }
+
+    class ThreadPool {
+    public:
+        // polls before a worker parks, a few tens of microseconds, longer than the gap between loops of a query
+        static const int SPINS = 1 << 14;
+
+        // threads counts the caller, workers are pinned to the cpus the process may use, the caller is not
+        // pinned since threads it creates later (OpenMP ones) would inherit its mask. With more threads than
+        // cpus spinning only delays the thread being waited for, so waits yield at once
+        explicit ThreadPool(int threads = std::thread::hardware_concurrency(), bool pin = true)
+                : threads(threads > 1 ? threads : 1) {
+            std::vector<int> cpus = allowedCpus();
+            spins = cpus.empty() || this->threads <= (int) cpus.size() ? SPINS : 0;
+            for (int index = 1; index < this->threads; index++) {
+                int cpu = pin && !cpus.empty() ? cpus[index % cpus.size()] : -1;
+                workers.emplace_back(&ThreadPool::workerLoop, this, index, cpu);
+            }
+        }
+
+        ~ThreadPool() {
+            stopped.store(true);
+            generation.fetch_add(1);
+            {
+                std::lock_guard<std::mutex> lock(parking);
+                wakeup.notify_all();
+            }
+            for (std::thread &worker : workers) {
+                worker.join();
+            }
+        }
+
+        ThreadPool(const ThreadPool &) = delete;
+
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        int size() const {
+            return threads;
+        }
+
+        // task(thread, count) once on every thread, like an omp parallel region
+        template<class Task>
+        void run(Task task) {
+            std::unique_lock<std::mutex> owner(dispatch, std::try_to_lock);
+            bool &inside = insideLoop();
+            if (threads == 1 || inside || !owner.owns_lock()) {
+                task(0, 1);
+                return;
+            }
+            inside = true;
+            publish([](void *job, int thread, int count) { (*static_cast<Task *>(job))(thread, count); }, &task);
+            task(0, threads);
+            waitWorkers();
+            inside = false;
+        }
+
+        // body(begin, end) on chunks covering [from, to). grain is the chunk size: 0 gives static loops one block
+        // per thread and dynamic ones single iterations, for guided loops it is the smallest chunk
+        template<class Body>
+        void parallelFor(int64_t from, int64_t to, Body body, int schedule = STATIC, int64_t grain = 0) {
+            Loop loop(from, to, schedule, grain);
+            run([&](int thread, int count) {
+                loop.forChunks(thread, count, body);
+            });
+        }
+
+        // body(begin, end, partial) folds chunks into a partial of the thread started from identity,
+        // partials are combined in thread order, so static loops give the same result on every run
+        template<class T, class Body, class Combine>
+        T parallelReduce(int64_t from, int64_t to, T identity, Body body, Combine combine, int schedule = STATIC,
+                         int64_t grain = 0) {
+            Loop loop(from, to, schedule, grain);
+            std::vector<Padded<T>> partials(threads, Padded<T>(identity));
+            run([&](int thread, int count) {
+                T &partial = partials[thread].value;
+                loop.forChunks(thread, count, [&](int64_t begin, int64_t end) {
+                    body(begin, end, partial);
+                });
+            });
+            T result = identity;
+            for (const Padded<T> &partial : partials) {
+                result = combine(result, partial.value);
+            }
+            return result;
+        }
+
+    private:
+        typedef void (*Invoke)(void *job, int thread, int count);
+
+        // keeps partials of neighbouring threads on different cache lines
+        template<class T>
+        struct Padded {
+            T value;
+            char padding[64];
+
+            explicit Padded(const T &value) : value(value), padding() {}
+        };
+
+        // iteration space of one loop and the shared cursor of dynamic and guided schedules
+        struct Loop {
+            int64_t from;
+            int64_t to;
+            int schedule;
+            int64_t grain;
+            alignas(64) std::atomic<int64_t> next;
+
+            Loop(int64_t from, int64_t to, int schedule, int64_t grain)
+                    : from(from), to(to), schedule(schedule), grain(grain), next(from) {}
+
+            template<class Body>
+            void forChunks(int thread, int count, Body &&body) {
+                int64_t size = grain > 0 ? grain : 1;
+                if (schedule == STATIC && grain <= 0) {
+                    int64_t begin = from + (to - from) * thread / count;
+                    int64_t end = from + (to - from) * (thread + 1) / count;
+                    if (begin < end) {
+                        body(begin, end);
+                    }
+                } else if (schedule == STATIC) {
+                    // chunks dealt round robin like schedule(static, grain)
+                    for (int64_t begin = from + thread * size; begin < to; begin += count * size) {
+                        body(begin, begin + size < to ? begin + size : to);
+                    }
+                } else if (schedule == DYNAMIC) {
+                    for (int64_t begin; (begin = next.fetch_add(size, std::memory_order_relaxed)) < to;) {
+                        body(begin, begin + size < to ? begin + size : to);
+                    }
+                } else {
+                    // half of the even share of what is left, never below grain
+                    int64_t begin = next.load(std::memory_order_relaxed);
+                    while (begin < to) {
+                        int64_t chunk = (to - begin) / (2 * count);
+                        chunk = chunk > size ? chunk : size;
+                        if (next.compare_exchange_weak(begin, begin + chunk, std::memory_order_relaxed)) {
+                            body(begin, begin + chunk < to ? begin + chunk : to);
+                            begin = next.load(std::memory_order_relaxed);
+                        }
+                    }
+                }
+            }
+        };
+
+        int threads;
+        int spins;
+        std::vector<std::thread> workers;
+        std::mutex dispatch;
+        Invoke invoke = nullptr;
+        void *job = nullptr;
+        alignas(64) std::atomic<uint64_t> generation{0};
+        alignas(64) std::atomic<int> running{0};
+        std::atomic<int> sleeping{0};
+        std::atomic<bool> stopped{false};
+        std::mutex parking;
+        std::condition_variable wakeup;
+
+        static std::vector<int> allowedCpus() {
+            std::vector<int> cpus;
+#ifdef __linux__
+            cpu_set_t set;
+            if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+                for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+                    if (CPU_ISSET(cpu, &set)) {
+                        cpus.push_back(cpu);
+                    }
+                }
+            }
+#elif defined(_WIN32)
+            DWORD_PTR process_mask, system_mask;
+            if (GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask)) {
+                for (int cpu = 0; cpu < (int) sizeof(DWORD_PTR) * 8; cpu++) {
+                    if (process_mask >> cpu & 1) {
+                        cpus.push_back(cpu);
+                    }
+                }
+            }
+#endif
+            return cpus;
+        }
+
+        static void pinTo(int cpu) {
+            if (cpu < 0) {
+                return;
+            }
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#elif defined(_WIN32)
+            SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR) 1 << cpu);
+#endif
+        }
+
+        // the job is written before the generation moves and stays until every worker has reported back;
+        // seq_cst on generation and sleeping makes either the worker see the new generation or the caller
+        // see the parked worker
+        void publish(Invoke next_invoke, void *next_job) {
+            invoke = next_invoke;
+            job = next_job;
+            running.store(threads - 1, std::memory_order_relaxed);
+            generation.fetch_add(1);
+            if (sleeping.load() > 0) {
+                std::lock_guard<std::mutex> lock(parking);
+                wakeup.notify_all();
+            }
+        }
+
+        void waitWorkers() {
+            for (int spin = 0; running.load(std::memory_order_acquire) > 0; spin++) {
+                if (spin < spins) {
+                    cpuRelax();
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+        uint64_t waitGeneration(uint64_t seen) {
+            for (int spin = 0; spin < spins; spin++) {
+                uint64_t current = generation.load(std::memory_order_acquire);
+                if (current != seen) {
+                    return current;
+                }
+                cpuRelax();
+            }
+            std::unique_lock<std::mutex> lock(parking);
+            sleeping.fetch_add(1);
+            uint64_t current;
+            while ((current = generation.load()) == seen) {
+                wakeup.wait(lock);
+            }
+            sleeping.fetch_sub(1);
+            return current;
+        }
+
+        void workerLoop(int index, int cpu) {
+            pinTo(cpu);
+            insideLoop() = true;
+            uint64_t seen = 0;
+            while (true) {
+                seen = waitGeneration(seen);
+                if (stopped.load()) {
+                    return;
+                }
+                invoke(job, index, threads);
+                running.fetch_sub(1, std::memory_order_release);
+            }
+        }
+    };
+}
+
+#endif //THREAD_POOL_H